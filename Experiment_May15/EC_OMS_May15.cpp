@@ -5,102 +5,1348 @@
 #include <chrono>
 #include <cstring>
 #include <fstream>
+#include <sstream>
 #include <opencv2/opencv.hpp>
-#include <vitis/ai/classification.hpp>
+#include <memory>
+#include <functional>
+#include <unordered_set>
+#include <unordered_map>
+#include <deque>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <cstdlib>
+#include <climits>
+#include <cmath>
+#include "../oms_protocol.h"
+#include "../buffer_pool.h"
+#include "../stage_queue.h"
+#include "ec_models.h"
 
 const int PORT = 5000;
+const double BATCH_EXTRA = 0.6;    // prior cost of each further image in a batch, relative to one
+const double SERVICE_ALPHA = 0.2;  // EWMA weight of a new batch time sample
+const int UNHOSTED_RETRY_MS = 10000;  // retry-after for a model this EC does not host
+const int LATENCY_BUCKETS = 10000;    // 1 ms latency histogram buckets, the last one open-ended
+const int DEVICE_ACTIVE_MS = 1000;    // a device competes for a model this long after its last REQ
 std::mutex queue_mutex;
 
-int queue_size = 0;
+int num_decoders = 2;         // decode + resize threads
+int num_instances = 1;        // accelerator workers, each with one instance of every hosted model
+int num_responders = 1;       // threads sending DONE with the results
+int max_batch = 4;            // images per inference call
+int batch_wait_ms = 2;        // longest a partial batch waits for more images
+bool codel = false;           // --aqm=codel
+int codel_target_ms = 50;     // acceptable standing wait in the EC
+int codel_interval_ms = 200;  // how long the wait may stay above target before shedding
+bool verbose = false;         // --verbose: log every request; otherwise only the periodic report
+int epoll_fd = -1;
+BufferPool payload_pool;      // uploads are received into and decoded from these
+
+// How accelerator workers pick the next model to serve (--share)
+//   none: the model whose first task comes first under --discipline
+//   fair: the backlogged model that has used the least accelerator time
+//         relative to its --weight, so each keeps its share under overload
+enum class SharePolicy { NONE, FAIR };
+SharePolicy share_policy = SharePolicy::FAIR;
+
+// Order of decoded tasks waiting for the accelerator (--discipline), within
+// a model and, with --share=none, across models
+//   fifo: decode order
+//   edf:  earliest deadline first, tasks without one last
+//   sjf:  least expected accelerator time per image first; all images of a
+//         model cost the same, so this only orders models, and under
+//         overload it can starve the costlier ones. Needs --share=none, as
+//         fair sharing already decides which model goes next
+enum class Discipline { FIFO, EDF, SJF };
+Discipline discipline = Discipline::FIFO;
+
+const char* discipline_name(Discipline d) {
+    return d == Discipline::EDF ? "edf" : d == Discipline::SJF ? "sjf" : "fifo";
+}
+
+// How the tasks of competing EDs share a model (--device-share), told apart
+// by the device tag of their requests
+//   none: first come, first served; a fast ED can take the whole queue
+//   fair: a device may hold at most its --device-weight share of a model's
+//         queue slots while other devices compete for it, and the
+//         accelerator takes each model's tasks from its devices in weighted
+//         round robin
+enum class DeviceShare { NONE, FAIR };
+DeviceShare device_share = DeviceShare::FAIR;
+
+using Clock = std::chrono::steady_clock;
+const Clock::time_point NO_DEADLINE = Clock::time_point::max();
+
+// EC sojourn times, REQ received to DONE sent, in 1 ms buckets
+struct LatencyStats {
+    std::vector<int64_t> hist = std::vector<int64_t>(LATENCY_BUCKETS, 0);
+    double sum_ms = 0;
+    int64_t completed = 0;
+    int64_t late = 0;               // completed after the task's deadline
+
+    void add(double ms, bool missed) {
+        hist[std::min(LATENCY_BUCKETS - 1, static_cast<int>(ms))]++;
+        sum_ms += ms;
+        completed++;
+        if (missed) late++;
+    }
+
+    int percentile(double p) const {
+        int64_t rank = static_cast<int64_t>(p * completed), seen = 0;
+        for (int ms = 0; ms < LATENCY_BUCKETS; ++ms) {
+            seen += hist[ms];
+            if (seen > rank) return ms;
+        }
+        return LATENCY_BUCKETS;
+    }
+
+    std::string summary() const {
+        std::ostringstream text;
+        text << "mean " << static_cast<int>(completed ? sum_ms / completed : 0) << " / p50 " << percentile(0.5)
+             << " / p99 " << percentile(0.99) << " ms over " << completed << " (" << late << " late)";
+        return text.str();
+    }
+};
+
+// A model the EC can host. service_ms and wait_budget_ms are the offline
+// DPU measurements the per-model EC binaries used to hard-code; batch_ms
+// starts from them and then follows the batch times the inference stage
+// measures. Everything below the instances is guarded by queue_mutex.
+struct HostedModel {
+    double service_ms;
+    int wait_budget_ms;             // longest queueing delay we admit, --wait-budget
+    bool hosted = false;            // --models
+    double weight = 1;              // accelerator share under --share=fair, --weight
+    std::vector<std::unique_ptr<ModelRunner>> instances;  // one per accelerator worker
+    StageQueue<cv::Mat> free_inputs;  // decoded images at the model's input size
+
+    std::vector<double> batch_ms;   // EWMA per batch size, index 0 unused
+    int queue_size = 0;             // admitted and not finished, including in_transfer
+    int in_transfer = 0;            // GRANTed, image not received yet
+    int credits_outstanding = 0;    // slots reserved by credits not yet spent
+    int credit_conns = 0;           // connections subscribed to credits for it
+    std::atomic<bool> shedding{false};  // CoDel found a standing queue, not guarded
+
+    LatencyStats latency;
+
+    HostedModel(double service, int budget) : service_ms(service), wait_budget_ms(budget) {}
+};
+HostedModel models[oms::MODEL_COUNT] = {
+    {32.33, 250},  // resnet_50
+    {68.71, 550},  // yolov5s
+    {32.33, 250},  // retinaface
+    {60.27, 230},  // ssd
+};
+
+// An edge device, as tagged in MsgHeader.device. Guarded by queue_mutex.
+struct EdDevice {
+    double weight = 1;                         // --device-weight
+    int queued[oms::MODEL_COUNT] = {};         // admitted and not finished
+    int credits[oms::MODEL_COUNT] = {};        // unspent credits of its connections
+    Clock::time_point last_req[oms::MODEL_COUNT] = {};
+    int64_t requests = 0;
+    int64_t offloaded = 0;                     // admitted
+    int64_t over_share = 0;                    // dropped for exceeding its share
+    LatencyStats latency;
+};
+EdDevice devices[oms::DEVICE_COUNT];
+
+double link_bytes_per_ms = 0; // EWMA of upload throughput seen on DATA frames, 0 = unknown
 int tasks_on_ec = 0;
 int tasks_dropped = 0;
+int tasks_missed = 0;         // dropped because the deadline could not be met
+int tasks_unhosted = 0;       // dropped because the model is not loaded here
+int tasks_cancelled = 0;      // skipped after the ED's hedged local copy won
+int tasks_undecodable = 0;    // payload was not an image, sent back to the ED
+int tasks_shed = 0;           // bounced back to the ED by CoDel after waiting too long
+
+// The helpers below expect queue_mutex to be held.
+// Frees the queue slot of a finished, dropped or abandoned task
+void release_slot(uint8_t model, uint8_t device) {
+    models[model].queue_size--;
+    devices[device].queued[model]--;
+}
+
+double batch_service_ms(uint8_t model, int batch) {
+    return models[model].batch_ms[batch];
+}
+
+void observe_batch(uint8_t model, int batch, double ms) {
+    double& est = models[model].batch_ms[batch];
+    est += SERVICE_ALPHA * (ms - est);
+}
+
+int total_queued() {
+    int total = 0;
+    for (const auto& hm : models) total += hm.queue_size;
+    return total;
+}
+
+int total_in_transfer() {
+    int total = 0;
+    for (const auto& hm : models) total += hm.in_transfer;
+    return total;
+}
+
+// Admitted tasks of a model are served FIFO by num_instances workers in
+// parallel, in batches of up to max_batch once there is a backlog. A task
+// with `ahead` tasks of its model in front of it waits for the full rounds
+// ahead and then rides in a batch with the remainder.
+int queue_wait_ms(uint8_t model, int ahead) {
+    int round = num_instances * max_batch;
+    return static_cast<int>(ahead / round * batch_service_ms(model, max_batch));
+}
+
+int queue_finish_ms(uint8_t model, int ahead) {
+    int round = num_instances * max_batch;
+    int batch = std::min(max_batch, ahead % round / num_instances + 1);
+    return queue_wait_ms(model, ahead) + static_cast<int>(batch_service_ms(model, batch));
+}
+
+// Accelerator time the admitted tasks of a model still need, spread over
+// the workers
+double backlog_ms(uint8_t model) {
+    return models[model].queue_size * batch_service_ms(model, max_batch) / (max_batch * num_instances);
+}
+
+// How much the other hosted models delay work of `model` that needs own_ms
+// of accelerator time. Without sharing that is all of their backlog, or
+// under sjf only that of models with cheaper images; under fair sharing at
+// most their weighted share of the time own_ms takes.
+int shared_delay_ms(uint8_t model, int own_ms) {
+    double others = 0, other_weight = 0;
+    double own_cost = batch_service_ms(model, 1);
+    for (uint8_t m = 0; m < oms::MODEL_COUNT; ++m) {
+        if (m == model || !models[m].hosted || models[m].queue_size == 0) continue;
+        if (share_policy == SharePolicy::NONE && discipline == Discipline::SJF && batch_service_ms(m, 1) > own_cost)
+            continue;
+        others += backlog_ms(m);
+        other_weight += models[m].weight;
+    }
+    if (share_policy == SharePolicy::NONE) return static_cast<int>(others);
+    return static_cast<int>(std::min(others, own_ms * other_weight / models[model].weight));
+}
+
+// Tasks admissible within a queueing delay of budget_ms
+int slots_within(uint8_t model, int budget_ms) {
+    int rounds = static_cast<int>(budget_ms / batch_service_ms(model, max_batch));
+    return rounds * max_batch * num_instances;
+}
+
+int capacity_slots(uint8_t model) {
+    return slots_within(model, models[model].wait_budget_ms) + max_batch * num_instances;
+}
+
+bool device_active(uint8_t device, uint8_t model, Clock::time_point now) {
+    const EdDevice& dev = devices[device];
+    return dev.queued[model] > 0 || now - dev.last_req[model] < std::chrono::milliseconds(DEVICE_ACTIVE_MS);
+}
+
+// Total weight of the devices other than `device` competing for a model
+double other_device_weight(uint8_t model, uint8_t device, Clock::time_point now) {
+    double weight = 0;
+    for (uint8_t d = 0; d < oms::DEVICE_COUNT; ++d)
+        if (d != device && device_active(d, model, now)) weight += devices[d].weight;
+    return weight;
+}
+
+// Queue slots of a model a device may hold: its weighted share of the
+// model's capacity among the devices competing for it, all of it alone
+int device_quota(uint8_t model, uint8_t device, Clock::time_point now) {
+    if (device_share == DeviceShare::NONE) return INT_MAX;
+    double weight = devices[device].weight;
+    double share = weight / (weight + other_device_weight(model, device, now));
+    return std::max(1, static_cast<int>(capacity_slots(model) * share));
+}
+
+// Tasks of a model served before a new one from `device`, given `queued`
+// in total: all of them without device sharing; with it the device's own
+// backlog, plus as much of the others' as the round robin interleaves.
+int device_ahead(uint8_t model, uint8_t device, int queued, Clock::time_point now) {
+    if (device_share == DeviceShare::NONE) return queued;
+    int own = devices[device].queued[model];
+    double others = other_device_weight(model, device, now);
+    return own + std::min(queued - own, static_cast<int>((own + 1) * others / devices[device].weight));
+}
+
+// Expected upload time of an image of the given size, 0 if unknown
+int transfer_ms(uint32_t bytes) {
+    return link_bytes_per_ms > 0 ? static_cast<int>(bytes / link_bytes_per_ms) : 0;
+}
+
+// One ED connection. All sockets are non-blocking and owned by the event
+// loop in main(), which also parses incoming frames. Replies come from the
+// loop (GRANT/DROP) and from pipeline workers (DONE): each one is appended
+// to the out buffer and sent right away; whatever the socket does not take
+// is flushed by the loop on EPOLLOUT. The socket is closed once the loop and
+// every queued task have let go of the connection.
+struct EdConn {
+    int fd;
+    std::mutex send_mutex;
+    std::string out;             // unsent reply bytes, guarded by send_mutex
+    bool want_write = false;     // EPOLLOUT registered, same
+    struct Grant {
+        uint8_t model;
+        uint8_t device;
+        Clock::time_point arrived;   // REQ received
+        Clock::time_point deadline;  // NO_DEADLINE if the REQ had no budget
+    };
+    std::unordered_map<uint32_t, Grant> granted;   // GRANTed, no DATA yet; guarded by queue_mutex
+    std::unordered_set<uint32_t> queued;     // handed to inference, not started; same
+    int credits = 0;             // unspent credits, guarded by queue_mutex
+    bool wants_credits = false;
+    uint32_t slo_ms = 0;         // ED's deadline budget from MSG_CREDIT, 0 = none
+    uint8_t model = oms::MODEL_RESNET50;  // the credits are for, from MSG_CREDIT
+    uint8_t device = oms::DEVICE_UNKNOWN;  // same
+
+    // Frame being received, only touched by the event loop
+    char head[oms::HEADER_SIZE];
+    size_t head_got = 0;
+    oms::MsgHeader hdr;
+    BufferPool::Buffer payload;
+    size_t payload_got = 0;
+    std::chrono::steady_clock::time_point payload_start;
+
+    explicit EdConn(int sock) : fd(sock) {}
+    ~EdConn() { close(fd); }
+
+    void reply(const oms::MsgHeader& req, uint8_t type, uint32_t arg = 0) {
+        reply(req, type, arg, std::string());
+    }
+
+    void reply(const oms::MsgHeader& req, uint8_t type, uint32_t arg, const std::string& payload) {
+        oms::MsgHeader hdr = req;
+        hdr.type = type;
+        hdr.arg = arg;
+        hdr.payload_len = payload.size();
+        char head[oms::HEADER_SIZE];
+        oms::encode_header(hdr, head);
+        std::lock_guard<std::mutex> lock(send_mutex);
+        out.append(head, sizeof(head));
+        out.append(payload);
+        flush_locked();
+    }
+
+    // DROP of a task admitted earlier
+    void drop_late(const oms::MsgHeader& req, uint32_t retry_after_ms) {
+        oms::MsgHeader late = req;
+        late.flags |= oms::FLAG_LATE;
+        reply(late, oms::MSG_DROP, retry_after_ms);
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        flush_locked();
+    }
+
+private:
+    void flush_locked() {
+        while (!out.empty()) {
+            ssize_t n = send(fd, out.data(), out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) out.clear();  // peer is gone
+                break;
+            }
+            out.erase(0, n);
+        }
+        bool need = !out.empty();
+        if (need == want_write) return;
+        want_write = need;
+        epoll_event ev{};
+        ev.events = need ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    }
+};
+
+// Tops a credit-subscribed connection up to its share of the free capacity
+// of its model, within its device's share. Credits reserve queue slots, so
+// a credited task can be admitted blind; an ED with a tight SLO only gets
+// credits for slots that can still meet it.
+void grant_credits(const std::shared_ptr<EdConn>& conn) {
+    int n;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (!conn->wants_credits) return;
+        HostedModel& hm = models[conn->model];
+        if (!hm.hosted) return;
+        int capacity = capacity_slots(conn->model);
+        if (conn->slo_ms) capacity = std::min(capacity, slots_within(conn->model, conn->slo_ms));
+        int share = std::max(1, capacity_slots(conn->model) / std::max(1, hm.credit_conns));
+        int free_slots = capacity - hm.queue_size - hm.credits_outstanding;
+        EdDevice& dev = devices[conn->device];
+        int quota = device_quota(conn->model, conn->device, Clock::now());
+        if (quota != INT_MAX) free_slots = std::min(free_slots, quota - dev.queued[conn->model] - dev.credits[conn->model]);
+        n = std::min(free_slots, share - conn->credits);
+        if (n <= 0) return;
+        conn->credits += n;
+        hm.credits_outstanding += n;
+        dev.credits[conn->model] += n;
+    }
+    oms::MsgHeader hdr;
+    hdr.model = conn->model;
+    conn->reply(hdr, oms::MSG_CREDIT, n);
+}
+
+// Admitted tasks flow through a pipeline of stages joined by bounded
+// queues, so decoding the next images overlaps with inference on the
+// current batch:
+//   receive (event loop) -> decode + resize -> inference -> respond
+// Decoded images live in a fixed set of input buffers per model that return
+// to its free_inputs after inference; running out of them throttles the
+// decoders. Every queue holds at most what admission let in, so threads and
+// memory stay flat however many EDs are connected.
+struct Job {
+    std::shared_ptr<EdConn> conn;
+    oms::MsgHeader hdr;        // hdr.model selects the hosted model, hdr.device the ED
+    BufferPool::Buffer image;  // encoded upload, released once decoded
+    double recv_ms = 0;        // header to last payload byte
+    double decode_ms = 0;
+    cv::Mat input;             // from the model's free_inputs
+    Clock::time_point arrived;   // REQ received
+    Clock::time_point deadline;  // arrived + the REQ's budget, NO_DEADLINE without one
+    Clock::time_point queued;    // image received, entered the pipeline
+    Clock::time_point decoded;
+    std::string result;
+    double infer_ms = 0;       // of the whole batch
+    size_t batch_size = 0;
+};
+
+// CoDel (Nichols and Jacobson) on how long tasks have waited in the EC
+// since their image arrived. Admission only predicts the wait; once the
+// shortest wait has stayed above codel_target_ms for codel_interval_ms, a
+// standing queue has formed, and tasks are bounced back to their EDs at a
+// rate rising with the square root of the bounce count until the wait
+// drops below target again. Less than a batch queued is never standing.
+struct CoDel {
+    Clock::time_point first_above{};  // when the wait will have stayed above target for an interval
+    Clock::time_point shed_next{};
+    bool shedding = false;
+    int count = 0;
+    int last_count = 0;
+
+    // Whether to bounce a task that waited `sojourn`, with `backlog`
+    // admitted tasks of its model behind it
+    bool should_shed(Clock::time_point now, Clock::duration sojourn, size_t backlog) {
+        auto interval = std::chrono::milliseconds(codel_interval_ms);
+        bool above = false;
+        if (sojourn < std::chrono::milliseconds(codel_target_ms) || static_cast<int>(backlog) < max_batch) {
+            first_above = Clock::time_point{};
+        } else if (first_above == Clock::time_point{}) {
+            first_above = now + interval;
+        } else if (now >= first_above) {
+            above = true;
+        }
+
+        if (shedding) {
+            if (!above) {
+                shedding = false;
+                return false;
+            }
+            if (now < shed_next) return false;
+            count++;
+            shed_next = control_law(shed_next);
+            return true;
+        }
+        if (!above) return false;
+        // Resume near the previous rate if the last episode ended recently
+        shedding = true;
+        int delta = count - last_count;
+        count = delta > 1 && now - shed_next < 16 * interval ? delta : 1;
+        shed_next = control_law(now);
+        last_count = count;
+        return true;
+    }
+
+    Clock::time_point control_law(Clock::time_point t) const {
+        return t + std::chrono::microseconds(static_cast<int64_t>(codel_interval_ms * 1000 / std::sqrt(count)));
+    }
+};
+
+// Decoded tasks waiting for an accelerator worker, per model and within it
+// per device, each in --discipline order. Capacity is bounded by each
+// model's input buffers, so the sorted insert under edf stays cheap.
+class AcceleratorQueue {
+public:
+    void push(Job job) {
+        uint8_t m = job.hdr.model, d = job.hdr.device;
+        job.decoded = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        ModelQueue& q = ready_[m];
+        // A model or device that was idle starts from the current virtual
+        // time, so it cannot bank a share it did not ask for
+        if (q.size == 0) used_ms_[m] = std::max(used_ms_[m], vtime_ * models[m].weight);
+        if (q.tasks[d].empty()) q.taken[d] = std::max(q.taken[d], q.vtime * devices[d].weight);
+        // All images of a model cost the same, so only edf reorders them
+        auto pos = q.tasks[d].end();
+        if (discipline == Discipline::EDF)
+            pos = std::upper_bound(q.tasks[d].begin(), q.tasks[d].end(), job.deadline,
+                                   [](Clock::time_point dl, const Job& j) { return dl < j.deadline; });
+        q.tasks[d].insert(pos, std::move(job));
+        q.size++;
+        size_++;
+        cv_.notify_one();
+    }
+
+    // Picks a model by share_policy and takes up to max_batch of its tasks,
+    // from its devices by device_share. A partial batch waits up to
+    // batch_wait_ms for more only while admitted tasks of that model are
+    // still on their way (granted, decoding or queued beyond this batch),
+    // so a lone task at light load runs immediately and batches grow with
+    // the backlog. With --aqm=codel, tasks CoDel sheds go to `shed` instead.
+    uint8_t pop_batch(std::vector<Job>& out, std::vector<Job>& shed) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return size_ > 0; });
+        uint8_t m = pick_locked();
+        ModelQueue& q = ready_[m];
+        vtime_ = used_ms_[m] / models[m].weight;
+        auto give_up = Clock::now() + std::chrono::milliseconds(batch_wait_ms);
+        int admitted = 0;  // of this model, the backlog CoDel looks at
+        if (codel) {
+            std::lock_guard<std::mutex> qlock(queue_mutex);
+            admitted = models[m].queue_size;
+        }
+        while (true) {
+            while (q.size > 0 && static_cast<int>(out.size()) < max_batch) {
+                int d = next_device(q);
+                q.vtime = q.taken[d] / devices[d].weight;
+                q.taken[d]++;
+                Job job = std::move(q.tasks[d].front());
+                q.tasks[d].pop_front();
+                q.size--;
+                size_--;
+                auto now = Clock::now();
+                int behind = admitted - static_cast<int>(out.size() + shed.size()) - 1;
+                if (codel && q.codel.should_shed(now, now - job.queued, std::max(0, behind)))
+                    shed.push_back(std::move(job));
+                else
+                    out.push_back(std::move(job));
+                models[m].shedding = q.codel.shedding;
+            }
+            if (static_cast<int>(out.size()) == max_batch) break;
+            int pending;
+            {
+                std::lock_guard<std::mutex> qlock(queue_mutex);
+                pending = models[m].queue_size;
+            }
+            if (pending - static_cast<int>(shed.size()) <= static_cast<int>(out.size())) break;
+            if (cv_.wait_until(lock, give_up) == std::cv_status::timeout && q.size == 0) break;
+        }
+        return m;
+    }
+
+    // Books accelerator time spent on a model
+    void charge(uint8_t model, double ms) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        used_ms_[model] += ms;
+        served_ms_[model] += ms;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return size_;
+    }
+
+    // Accelerator time per model since the last call
+    void take_served(double* out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int m = 0; m < oms::MODEL_COUNT; ++m) {
+            out[m] = served_ms_[m];
+            served_ms_[m] = 0;
+        }
+    }
+
+private:
+    struct ModelQueue {
+        std::deque<Job> tasks[oms::DEVICE_COUNT];
+        size_t size = 0;
+        double taken[oms::DEVICE_COUNT] = {};  // images taken per device, for device fairness
+        double vtime = 0;                      // weighted images of the device served last
+        CoDel codel;
+    };
+
+    static bool runs_before(const Job& a, const Job& b) {
+        if (discipline == Discipline::EDF && a.deadline != b.deadline) return a.deadline < b.deadline;
+        return a.decoded < b.decoded;
+    }
+
+    // Device whose task a model serves next: the one with the fewest images
+    // taken relative to its weight under device sharing, else the one whose
+    // first task comes first
+    static int next_device(const ModelQueue& q) {
+        int best = -1;
+        for (int d = 0; d < oms::DEVICE_COUNT; ++d) {
+            if (q.tasks[d].empty()) continue;
+            if (best < 0) {
+                best = d;
+                continue;
+            }
+            if (device_share == DeviceShare::FAIR) {
+                double a = q.taken[d] / devices[d].weight, b = q.taken[best] / devices[best].weight;
+                if (a != b) {
+                    if (a < b) best = d;
+                    continue;
+                }
+            }
+            if (runs_before(q.tasks[d].front(), q.tasks[best].front())) best = d;
+        }
+        return best;
+    }
+
+    const Job& front(uint8_t m) const {
+        const ModelQueue& q = ready_[m];
+        return q.tasks[next_device(q)].front();
+    }
+
+    uint8_t pick_locked() {
+        double cost[oms::MODEL_COUNT] = {};
+        if (share_policy == SharePolicy::NONE && discipline == Discipline::SJF) {
+            std::lock_guard<std::mutex> qlock(queue_mutex);
+            for (uint8_t m = 0; m < oms::MODEL_COUNT; ++m)
+                if (ready_[m].size) cost[m] = batch_service_ms(m, 1);
+        }
+        int best = -1;
+        for (int m = 0; m < oms::MODEL_COUNT; ++m) {
+            if (ready_[m].size == 0) continue;
+            if (best < 0) {
+                best = m;
+            } else if (share_policy == SharePolicy::NONE) {
+                bool first = runs_before(front(m), front(best));
+                if (discipline == Discipline::SJF && cost[m] != cost[best]) first = cost[m] < cost[best];
+                if (first) best = m;
+            } else if (used_ms_[m] / models[m].weight < used_ms_[best] / models[best].weight) {
+                best = m;
+            }
+        }
+        return static_cast<uint8_t>(best);
+    }
 
-// Shared model instance
-auto model = vitis::ai::Classification::create("resnet50");
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    ModelQueue ready_[oms::MODEL_COUNT];
+    size_t size_ = 0;
+    double used_ms_[oms::MODEL_COUNT] = {};    // accelerator time, for fair sharing
+    double vtime_ = 0;                         // weighted usage of the model served last
+    double served_ms_[oms::MODEL_COUNT] = {};  // for the occupancy report
+};
 
-void handle_request(int client_socket) {
-    char buffer[256] = {0};
-    recv(client_socket, buffer, 255, 0);
-    std::string request(buffer);
+StageQueue<Job> decode_queue;
+AcceleratorQueue infer_queue;
+StageQueue<Job> respond_queue;
 
-    if (request.rfind("REQ:", 0) == 0) {
-        size_t pos1 = request.find(':');
-        size_t pos2 = request.find(':', pos1 + 1);
-        std::string token_ed = request.substr(pos1 + 1, pos2 - pos1 - 1);
+// Busy time per stage for the occupancy report
+struct StageStats {
+    const char* name;
+    int workers;
+    std::function<size_t()> depth;  // of the stage's input queue
+    std::atomic<int64_t> busy_us{0};
+    int64_t reported_us = 0;
+};
+StageStats decode_stats{"decode", 0, [] { return decode_queue.size(); }};
+StageStats infer_stats{"infer", 0, [] { return infer_queue.size(); }};
+StageStats respond_stats{"respond", 0, [] { return respond_queue.size(); }};
 
-        int local_queue;
+struct BusyTimer {
+    StageStats& stats;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    explicit BusyTimer(StageStats& s) : stats(s) {}
+    ~BusyTimer() {
+        stats.busy_us += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+// Hands an admitted upload to the decoders. Called on the event loop, so it
+// never blocks: if the decode stage is full, which admission can outrun when
+// the batch estimates it sized the stage from change, the task goes back to
+// its ED as a DROP instead.
+void submit_task(const std::shared_ptr<EdConn>& conn, const oms::MsgHeader& hdr, BufferPool::Buffer image,
+                 double recv_ms, Clock::time_point arrived, Clock::time_point deadline) {
+    Job job;
+    job.conn = conn;
+    job.hdr = hdr;
+    job.image = std::move(image);
+    job.recv_ms = recv_ms;
+    job.arrived = arrived;
+    job.deadline = deadline;
+    job.queued = Clock::now();
+    if (decode_queue.try_push(job)) return;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (conn->queued.erase(hdr.token) == 0) return;  // cancelled meanwhile
+        tasks_dropped++;
+        release_slot(hdr.model, hdr.device);
+    }
+    conn->drop_late(hdr, codel_target_ms);
+    grant_credits(conn);
+    if (verbose) std::cout << "[EC] Sent DROP for token_ed=" << hdr.token << " (decode stage full)\n";
+}
+
+// True if the ED cancelled the task while it was queued; its slot is
+// released. claim takes the task for inference, after which a CANCEL no
+// longer stops it.
+bool skip_cancelled(const Job& job, bool claim) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        bool live = claim ? job.conn->queued.erase(job.hdr.token) > 0
+                          : job.conn->queued.count(job.hdr.token) > 0;
+        if (live) return false;
+        tasks_cancelled++;
+        release_slot(job.hdr.model, job.hdr.device);
+    }
+    grant_credits(job.conn);
+    return true;
+}
+
+// Decodes each upload in place from its pooled buffer into a free input
+// buffer of its model. An upload that is not an image goes back to its ED
+// as a DROP, which makes it run the task locally.
+void decode_loop() {
+    while (true) {
+        Job job = decode_queue.pop();
+        if (skip_cancelled(job, false)) continue;
+        HostedModel& hm = models[job.hdr.model];
+        cv::Mat input = hm.free_inputs.pop();
+        BusyTimer busy(decode_stats);
+        cv::Mat raw(1, static_cast<int>(job.image.size()), CV_8UC1, job.image.data());
+        cv::Mat image = job.image.size() ? cv::imdecode(raw, cv::IMREAD_COLOR) : cv::Mat();
+        if (!image.empty()) cv::resize(image, input, input.size());
+        job.image = BufferPool::Buffer();
+        job.decode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - busy.start).count();
+        if (image.empty()) {
+            hm.free_inputs.push(input);
+            if (skip_cancelled(job, true)) continue;
+            job.conn->drop_late(job.hdr, 0);
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                tasks_undecodable++;
+                release_slot(job.hdr.model, job.hdr.device);
+            }
+            grant_credits(job.conn);
+            std::cerr << "[EC] Could not decode image for token_ed=" << job.hdr.token << "\n";
+            continue;
+        }
+        job.input = input;
+        infer_queue.push(std::move(job));
+    }
+}
+
+// Sends a task CoDel shed back to its ED, which runs it locally. The DROP's
+// retry-after is only the target: keeping the ED away for longer lets the
+// queue run dry and idles the accelerator, while CoDel already paces itself.
+void bounce(Job& job) {
+    models[job.hdr.model].free_inputs.push(job.input);
+    job.input = cv::Mat();
+    if (skip_cancelled(job, true)) return;
+    job.conn->drop_late(job.hdr, codel_target_ms);
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        tasks_shed++;
+        release_slot(job.hdr.model, job.hdr.device);
+    }
+    grant_credits(job.conn);
+    if (verbose)
+        std::cout << "[EC] Shed token_ed=" << job.hdr.token << " after waiting "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - job.queued).count() << " ms\n";
+}
+
+// Accelerator worker `worker`: runs batches of whichever model the
+// AcceleratorQueue picks on that model's instance for this worker. Tasks
+// cancelled while queued are skipped, and those CoDel sheds are bounced.
+void infer_loop(int worker) {
+    std::vector<Job> batch, shed;
+    std::vector<cv::Mat> images;
+    while (true) {
+        batch.clear();
+        shed.clear();
+        uint8_t m = infer_queue.pop_batch(batch, shed);
+        HostedModel& hm = models[m];
+        for (auto& job : shed) bounce(job);
+        BusyTimer busy(infer_stats);
+        images.clear();
+        size_t kept = 0;
+        for (auto& job : batch) {
+            if (skip_cancelled(job, true)) {
+                hm.free_inputs.push(job.input);
+                continue;
+            }
+            images.push_back(job.input);
+            if (&batch[kept] != &job) batch[kept] = std::move(job);
+            kept++;
+        }
+        batch.resize(kept);
+        if (batch.empty()) continue;
+
+        if (verbose)
+            std::cout << "[EC] Running inference on " << oms::model_name(m) << " (batch of " << batch.size() << ")...\n";
+        auto t0 = std::chrono::steady_clock::now();
+        auto results = hm.instances[worker]->run(images);
+        double infer_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
         {
             std::lock_guard<std::mutex> lock(queue_mutex);
-            local_queue = queue_size++;
+            observe_batch(m, batch.size(), infer_ms);
         }
+        infer_queue.charge(m, infer_ms);
 
-        int wait_ms = static_cast<int>(local_queue * 32.33);
-        if (wait_ms <= 250) {
-            int token_ec = local_queue;
-            std::string grant = "GRANT:" + std::to_string(token_ec);
-            send(client_socket, grant.c_str(), grant.size(), 0);
-            std::cout << "[EC] Sent GRANT to ED for token_ed=" << token_ed << ", token_ec=" << token_ec << "\n";
+        for (size_t i = 0; i < batch.size(); ++i) {
+            Job& job = batch[i];
+            hm.free_inputs.push(job.input);
+            job.input = cv::Mat();
+            if (i < results.size()) job.result = std::move(results[i]);
+            job.infer_ms = infer_ms;
+            job.batch_size = batch.size();
+            respond_queue.push(std::move(job));
+        }
+    }
+}
 
-            char ack_buf[256] = {0};
-            recv(client_socket, ack_buf, 255, 0);
+void respond_loop() {
+    while (true) {
+        Job job = respond_queue.pop();
+        BusyTimer busy(respond_stats);
+        job.conn->reply(job.hdr, oms::MSG_DONE, job.hdr.arg, job.result);
+        auto done = Clock::now();
+        double sojourn_ms = std::chrono::duration<double, std::milli>(done - job.arrived).count();
 
-            std::string ack(ack_buf);
-            if (ack.rfind("OK:", 0) == 0) {
-                std::cout << "[EC] Receiving image for token_ec=" << token_ec << "...\n";
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            tasks_on_ec++;
+            release_slot(job.hdr.model, job.hdr.device);
+            models[job.hdr.model].latency.add(sojourn_ms, done > job.deadline);
+            devices[job.hdr.device].latency.add(sojourn_ms, done > job.deadline);
+        }
 
-                // Just load from disk — ignore what was sent
-                cv::Mat image = cv::imread("COCO_test_1220/000000000664.jpg");
+        grant_credits(job.conn);
+        if (verbose)
+            std::cout << "[EC] Completed " << oms::model_name(job.hdr.model) << " task for token_ed=" << job.hdr.token
+                      << ", token_ec=" << job.hdr.arg << " (recv " << job.recv_ms << " ms, decode " << job.decode_ms
+                      << " ms, infer " << job.infer_ms << " ms in a batch of " << job.batch_size << ", "
+                      << job.result.size() << " result bytes)\n";
+    }
+}
+
+// Task counters, then the EC sojourn time of every task completed so far,
+// per hosted model, then per device with the share of its requests the EC
+// took
+std::string latency_report() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    std::ostringstream line;
+    line << "[EC] Queue Size: " << total_queued() << " (" << total_in_transfer() << " in transfer)"
+         << ", Tasks on EC: " << tasks_on_ec
+         << ", Dropped to ED: " << tasks_dropped
+         << " (deadline: " << tasks_missed << ", not hosted: " << tasks_unhosted << ")"
+         << ", Cancelled: " << tasks_cancelled
+         << ", Undecodable: " << tasks_undecodable
+         << ", Shed: " << tasks_shed << "\n";
+    line << "[EC] Latency (" << discipline_name(discipline) << "):";
+    for (uint8_t m = 0; m < oms::MODEL_COUNT; ++m) {
+        const HostedModel& hm = models[m];
+        if (hm.hosted && hm.latency.completed) line << " " << oms::model_name(m) << " " << hm.latency.summary() << ";";
+    }
+    line << "\n[EC] Devices (" << (device_share == DeviceShare::FAIR ? "fair" : "no") << " sharing):";
+    for (uint8_t d = 0; d < oms::DEVICE_COUNT; ++d) {
+        const EdDevice& dev = devices[d];
+        if (dev.requests == 0) continue;
+        line << " " << oms::device_name(d) << " offloaded " << dev.offloaded << "/" << dev.requests << " ("
+             << 100 * dev.offloaded / dev.requests << "%, " << dev.over_share << " over share), "
+             << dev.latency.summary() << ";";
+    }
+    return line.str();
+}
 
-                
-                // No need to check if empty
-                std::cout << "[EC] Running DPU inference on static image...\n";
-                auto result = model->run(image);
+// Prints how busy each stage's workers were over the last second, its input
+// queue depth, and how accelerator time was split between models, whenever
+// the pipeline did any work, followed by the task counters and latency so
+// far.
+void occupancy_loop() {
+    StageStats* stages[] = {&decode_stats, &infer_stats, &respond_stats};
+    double served[oms::MODEL_COUNT];
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        bool active = false;
+        std::string line = "[EC] Stage occupancy:";
+        for (StageStats* st : stages) {
+            int64_t busy = st->busy_us.load();
+            int64_t delta = busy - st->reported_us;
+            st->reported_us = busy;
+            active = active || delta > 0;
+            // Busy time is booked when work finishes, so clamp spillover
+            int percent = std::min(100, static_cast<int>(delta / (10000.0 * st->workers)));
+            line += std::string(st == stages[0] ? " " : ", ") + st->name + " " + std::to_string(percent) + "% of "
+                    + std::to_string(st->workers) + " (queue " + std::to_string(st->depth()) + ")";
+        }
+        infer_queue.take_served(served);
+        double total = 0;
+        for (double ms : served) total += ms;
+        if (total > 0) {
+            line += "; accelerator share:";
+            for (uint8_t m = 0; m < oms::MODEL_COUNT; ++m)
+                if (models[m].hosted)
+                    line += std::string(" ") + oms::model_name(m) + " " + std::to_string(static_cast<int>(100 * served[m] / total)) + "%";
+        }
+        if (active) std::cout << line << "\n" << latency_report() << "\n";
+    }
+}
 
-                for (const auto& r : result.scores) {
-                    std::cout << " - Class: " << result.lookup(r.index)
-                            << ", Score: " << r.score << "\n";
-                }
+// Handles one complete frame from an ED. Requests are routed by their model
+// field to that model's queue and admission. Admission is answered inline;
+// each DATA frame (or admitted eager REQ) is handed to the pipeline, so a
+// connection can have many tasks in flight and their DONEs may come back in
+// any order. A dropped eager REQ has already been read, so its bytes are
+// simply discarded.
+void handle_frame(const std::shared_ptr<EdConn>& conn, oms::MsgHeader hdr,
+                  BufferPool::Buffer payload, double recv_ms) {
+    auto now = Clock::now();
+    if (hdr.device >= oms::DEVICE_COUNT) hdr.device = oms::DEVICE_UNKNOWN;
+    if (hdr.type == oms::MSG_CREDIT) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (conn->wants_credits) models[conn->model].credit_conns--;
+            if (hdr.model < oms::MODEL_COUNT) conn->model = hdr.model;
+            conn->device = hdr.device;
+            models[conn->model].credit_conns++;
+            conn->wants_credits = true;
+            conn->slo_ms = hdr.budget_ms;
+        }
+        grant_credits(conn);
+    } else if (hdr.type == oms::MSG_REQ) {
+        if (hdr.model >= oms::MODEL_COUNT || !models[hdr.model].hosted) {
+            // Not loaded here; keep the ED from asking again for a while
+            conn->reply(hdr, oms::MSG_DROP, UNHOSTED_RETRY_MS);
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            tasks_dropped++;
+            tasks_unhosted++;
+            return;
+        }
+        HostedModel& hm = models[hdr.model];
+        EdDevice& dev = devices[hdr.device];
+        int local_queue, wait_ms, finish_ms, wait_budget_ms, share_retry_ms = 0;
+        bool credited = false, over_share = false, shedding = false;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            dev.requests++;
+            dev.last_req[hdr.model] = now;
+            if ((hdr.flags & oms::FLAG_CREDIT) && conn->credits > 0 && conn->model == hdr.model) {
+                conn->credits--;
+                hm.credits_outstanding--;
+                devices[conn->device].credits[conn->model]--;
+                credited = true;
+            }
+            local_queue = hm.queue_size++;
+            // Slots promised to other connections count as occupied
+            if (!credited) local_queue += hm.credits_outstanding;
 
-                std::string done_msg = "DONE";
-                send(client_socket, done_msg.c_str(), done_msg.size(), 0);
+            // A device past its share of the model's slots waits for its own
+            // backlog to drain back into it, however empty the queue is
+            int own = dev.queued[hdr.model]++;
+            int quota = device_quota(hdr.model, hdr.device, now);
+            over_share = !credited && own >= quota;
+            if (over_share) {
+                double rest = other_device_weight(hdr.model, hdr.device, now);
+                int excess = static_cast<int>((own - quota + 1) * (1 + rest / dev.weight));
+                share_retry_ms = queue_finish_ms(hdr.model, excess);
+            }
+            int ahead = device_ahead(hdr.model, hdr.device, local_queue, now);
+            // While CoDel sheds a standing queue, the measured wait overrules
+            // the predicted one. CoDel only notices the queue is gone on the
+            // next dequeue, so less than a batch queued always admits.
+            shedding = !credited && hm.shedding && hm.queue_size > max_batch;
 
-                {
-                    std::lock_guard<std::mutex> lock(queue_mutex);
-                    tasks_on_ec++;
-                    queue_size--;
-                }
+            // Images still in transfer are counted ahead, as they were
+            // promised their place; the upload of a lazy request's own
+            // image (arg = its size) overlaps with draining the queue.
+            // Other models' work delays it as far as the share policy lets.
+            int upload_ms = (hdr.flags & oms::FLAG_EAGER) ? 0 : transfer_ms(hdr.arg);
+            int queued_ms = queue_wait_ms(hdr.model, ahead);
+            int run_ms = queue_finish_ms(hdr.model, ahead) - queued_ms;
+            queued_ms += shared_delay_ms(hdr.model, queued_ms + run_ms);
+            wait_ms = std::max(0, queued_ms - upload_ms);
+            finish_ms = std::max(upload_ms, queued_ms) + run_ms;
+            wait_budget_ms = hm.wait_budget_ms;
+        }
 
-                std::cout << "[EC] Completed task for token_ed=" << token_ed << ", token_ec=" << token_ec << "\n";
+        bool meets_deadline = hdr.budget_ms == 0 || finish_ms <= static_cast<int>(hdr.budget_ms);
+        auto deadline = hdr.budget_ms ? now + std::chrono::milliseconds(hdr.budget_ms) : NO_DEADLINE;
+        bool admit = meets_deadline && !over_share && !shedding && (credited || wait_ms <= wait_budget_ms);
+        if (admit && (hdr.flags & oms::FLAG_EAGER)) {
+            // The image came with the request, skip the GRANT round trip
+            hdr.arg = local_queue;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                conn->queued.insert(hdr.token);
+                dev.offloaded++;
             }
+            if (verbose)
+                std::cout << "[EC] Admitted eager task token_ed=" << hdr.token << ", token_ec=" << local_queue << "\n";
+            submit_task(conn, hdr, std::move(payload), recv_ms, now, deadline);
+        } else if (admit) {
+            int token_ec = local_queue;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                conn->granted[hdr.token] = EdConn::Grant{hdr.model, hdr.device, now, deadline};
+                hm.in_transfer++;
+                dev.offloaded++;
+            }
+            conn->reply(hdr, oms::MSG_GRANT, token_ec);
+            if (verbose)
+                std::cout << "[EC] Sent GRANT to ED for token_ed=" << hdr.token << ", token_ec=" << token_ec << "\n";
         } else {
-            std::string drop = "DROP";
-            send(client_socket, drop.c_str(), drop.size(), 0);
-            std::cout << "[EC] Sent DROP for token_ed=" << token_ed << " (wait=" << wait_ms << "ms)\n";
+            // Tell the ED how long until the queue drains back into budget
+            int retry_after_ms = std::max(1, wait_ms - wait_budget_ms);
+            if (!meets_deadline)
+                retry_after_ms = std::max(retry_after_ms, finish_ms - static_cast<int>(hdr.budget_ms));
+            if (over_share) retry_after_ms = std::max(retry_after_ms, share_retry_ms);
+            if (shedding) retry_after_ms = std::max(retry_after_ms, codel_target_ms);
+            conn->reply(hdr, oms::MSG_DROP, retry_after_ms);
+            if (verbose)
+                std::cout << "[EC] Sent DROP for token_ed=" << hdr.token << " (wait=" << wait_ms
+                          << "ms, budget=" << hdr.budget_ms << "ms" << (over_share ? ", over device share" : "")
+                          << (shedding ? ", shedding" : "")
+                          << ", retry after " << retry_after_ms << "ms)\n";
 
             {
                 std::lock_guard<std::mutex> lock(queue_mutex);
                 tasks_dropped++;
-                queue_size--;
+                if (!meets_deadline) tasks_missed++;
+                if (over_share) dev.over_share++;
+                release_slot(hdr.model, hdr.device);
+            }
+            // A request without credit means the ED ran out; refill if we can
+            grant_credits(conn);
+        }
+    } else if (hdr.type == oms::MSG_DATA) {
+        EdConn::Grant grant;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            auto it = conn->granted.find(hdr.token);
+            if (it == conn->granted.end()) return;  // cancelled or never granted
+            grant = it->second;
+            hdr.model = grant.model;
+            hdr.device = grant.device;
+            models[hdr.model].in_transfer--;
+            conn->granted.erase(it);
+            conn->queued.insert(hdr.token);
+            if (hdr.payload_len && recv_ms > 0) {
+                double rate = hdr.payload_len / recv_ms;
+                link_bytes_per_ms = link_bytes_per_ms > 0 ? link_bytes_per_ms + SERVICE_ALPHA * (rate - link_bytes_per_ms)
+                                                          : rate;
+            }
+        }
+        if (verbose)
+            std::cout << "[EC] Received image for token_ec=" << hdr.arg << " (" << hdr.payload_len << " bytes)\n";
+        submit_task(conn, hdr, std::move(payload), recv_ms, grant.arrived, grant.deadline);
+    } else if (hdr.type == oms::MSG_CANCEL) {
+        // A granted task still waiting for its image frees its slot now;
+        // one already in the pipeline is skipped if inference has not
+        // started on it yet.
+        bool freed = false;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            auto it = conn->granted.find(hdr.token);
+            if (it != conn->granted.end()) {
+                tasks_cancelled++;
+                release_slot(it->second.model, it->second.device);
+                models[it->second.model].in_transfer--;
+                conn->granted.erase(it);
+                freed = true;
+            }
+            conn->queued.erase(hdr.token);
+        }
+        if (freed) grant_credits(conn);
+    }
+}
+
+// Releases queue slots granted to tasks whose image will never arrive, and
+// the slots reserved by credits the ED can no longer spend
+void release_conn(const std::shared_ptr<EdConn>& conn) {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    for (const auto& g : conn->granted) {
+        release_slot(g.second.model, g.second.device);
+        models[g.second.model].in_transfer--;
+    }
+    conn->granted.clear();
+    models[conn->model].credits_outstanding -= conn->credits;
+    devices[conn->device].credits[conn->model] -= conn->credits;
+    conn->credits = 0;
+    if (conn->wants_credits) models[conn->model].credit_conns--;
+    conn->wants_credits = false;
+}
+
+// Drains whatever the socket has and dispatches every frame completed by
+// it. Headers are read through a stack buffer; a payload is received into
+// a pooled buffer, directly from the socket once it is under way. Returns
+// false once the ED hung up or sent garbage.
+bool read_frames(const std::shared_ptr<EdConn>& conn) {
+    char buf[16 * 1024];
+    auto complete = [&conn]() {
+        double recv_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - conn->payload_start).count();
+        conn->head_got = 0;
+        handle_frame(conn, conn->hdr, std::move(conn->payload), recv_ms);
+    };
+    while (true) {
+        bool in_payload = conn->head_got == oms::HEADER_SIZE;
+        char* dst = in_payload ? conn->payload.data() + conn->payload_got : buf;
+        size_t want = in_payload ? conn->hdr.payload_len - conn->payload_got : sizeof(buf);
+        ssize_t n = recv(conn->fd, dst, want, 0);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (in_payload) {
+            conn->payload_got += n;
+            if (conn->payload_got == conn->hdr.payload_len) complete();
+            continue;
+        }
+        const char* p = buf;
+        while (n > 0) {
+            if (conn->head_got < oms::HEADER_SIZE) {
+                size_t take = std::min<size_t>(n, oms::HEADER_SIZE - conn->head_got);
+                memcpy(conn->head + conn->head_got, p, take);
+                conn->head_got += take;
+                p += take;
+                n -= take;
+                if (conn->head_got < oms::HEADER_SIZE) break;
+                if (!oms::decode_header(conn->head, conn->hdr)) return false;
+                if (conn->hdr.payload_len > oms::MAX_PAYLOAD) {
+                    std::cerr << "[EC] Closing connection: frame of " << conn->hdr.payload_len << " bytes\n";
+                    return false;
+                }
+                conn->payload = payload_pool.acquire(conn->hdr.payload_len);
+                conn->payload_got = 0;
+                conn->payload_start = std::chrono::steady_clock::now();
+            } else {
+                size_t take = std::min<size_t>(n, conn->hdr.payload_len - conn->payload_got);
+                memcpy(conn->payload.data() + conn->payload_got, p, take);
+                conn->payload_got += take;
+                p += take;
+                n -= take;
             }
+            if (conn->payload_got == conn->hdr.payload_len) complete();
         }
+    }
+}
 
-        std::cout << "[EC] Queue Size: " << queue_size
-                  << ", Tasks on EC: " << tasks_on_ec
-                  << ", Dropped to ED: " << tasks_dropped << "\n";
+// Parses "value" (every key) or "key:value[,key:value...]" and hands each
+// value to set, with key -1 for every key. lookup maps a key name to its
+// index.
+bool parse_keyed(const std::string& spec, const std::function<bool(const std::string&, int&)>& lookup,
+                 const std::function<void(int, double)>& set) {
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) end = spec.size();
+        std::string item = spec.substr(pos, end - pos);
+        size_t colon = item.find(':');
+        double value = std::atof(item.c_str() + (colon == std::string::npos ? 0 : colon + 1));
+        if (value <= 0) return false;
+        if (colon == std::string::npos) {
+            set(-1, value);
+        } else {
+            int key;
+            if (!lookup(item.substr(0, colon), key)) return false;
+            set(key, value);
+        }
+        pos = end + 1;
     }
+    return true;
+}
 
-    close(client_socket);
+// Model keys, "model:value"
+bool parse_per_model(const std::string& spec, const std::function<void(int, double)>& set) {
+    return parse_keyed(spec, [](const std::string& name, int& key) {
+        oms::ModelId model;
+        if (!oms::model_from_name(name, model)) return false;
+        key = model;
+        return true;
+    }, set);
 }
 
-int main() {
-    if (!model) {
-        std::cerr << "[EC] Failed to create model instance.\n";
+bool parse_models(const std::string& spec) {
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) end = spec.size();
+        oms::ModelId model;
+        if (!oms::model_from_name(spec.substr(pos, end - pos), model)) return false;
+        models[model].hosted = true;
+        pos = end + 1;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string hosted = "resnet_50";
+#ifdef EC_HAVE_VITIS
+    std::string backend_name = "vitis";
+#else
+    std::string backend_name = "cpu";
+#endif
+    std::string onnx_dir = ".";
+    ServiceDist service_dist;
+    bool spin = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--decoders=", 0) == 0) {
+            num_decoders = std::max(1, std::atoi(arg.c_str() + 11));
+        } else if (arg.rfind("--responders=", 0) == 0) {
+            num_responders = std::max(1, std::atoi(arg.c_str() + 13));
+        } else if (arg.rfind("--instances=", 0) == 0) {
+            num_instances = std::max(1, std::atoi(arg.c_str() + 12));
+        } else if (arg.rfind("--models=", 0) == 0) {
+            hosted = arg.substr(9);
+        } else if (arg == "--share=none" || arg == "--share=fair") {
+            share_policy = arg == "--share=none" ? SharePolicy::NONE : SharePolicy::FAIR;
+        } else if (arg == "--device-share=none" || arg == "--device-share=fair") {
+            device_share = arg == "--device-share=none" ? DeviceShare::NONE : DeviceShare::FAIR;
+        } else if (arg.rfind("--device-weight=", 0) == 0) {
+            auto lookup = [](const std::string& name, int& key) {
+                oms::DeviceId device;
+                if (!oms::device_from_name(name, device)) return false;
+                key = device;
+                return true;
+            };
+            bool ok = parse_keyed(arg.substr(16), lookup, [](int device, double w) {
+                for (int d = 0; d < oms::DEVICE_COUNT; ++d)
+                    if (device < 0 || device == d) devices[d].weight = w;
+            });
+            if (!ok) {
+                std::cerr << "Invalid --device-weight (expected w or device:w[,device:w...])\n";
+                return 1;
+            }
+        } else if (arg == "--aqm=none" || arg == "--aqm=codel") {
+            codel = arg == "--aqm=codel";
+        } else if (arg.rfind("--codel-target-ms=", 0) == 0) {
+            codel_target_ms = std::max(1, std::atoi(arg.c_str() + 18));
+        } else if (arg.rfind("--codel-interval-ms=", 0) == 0) {
+            codel_interval_ms = std::max(1, std::atoi(arg.c_str() + 20));
+        } else if (arg.rfind("--discipline=", 0) == 0) {
+            std::string name = arg.substr(13);
+            if (name == "fifo") discipline = Discipline::FIFO;
+            else if (name == "edf") discipline = Discipline::EDF;
+            else if (name == "sjf") discipline = Discipline::SJF;
+            else {
+                std::cerr << "Invalid --discipline (expected fifo, edf or sjf)\n";
+                return 1;
+            }
+        } else if (arg.rfind("--weight=", 0) == 0) {
+            bool ok = parse_per_model(arg.substr(9), [](int model, double w) {
+                for (int m = 0; m < oms::MODEL_COUNT; ++m)
+                    if (model < 0 || model == m) models[m].weight = w;
+            });
+            if (!ok) {
+                std::cerr << "Invalid --weight (expected w or model:w[,model:w...])\n";
+                return 1;
+            }
+        } else if (arg.rfind("--wait-budget=", 0) == 0) {
+            bool ok = parse_per_model(arg.substr(14), [](int model, double ms) {
+                for (int m = 0; m < oms::MODEL_COUNT; ++m)
+                    if (model < 0 || model == m) models[m].wait_budget_ms = static_cast<int>(ms);
+            });
+            if (!ok) {
+                std::cerr << "Invalid --wait-budget (expected ms or model:ms[,model:ms...])\n";
+                return 1;
+            }
+        } else if (arg.rfind("--backend=", 0) == 0) {
+            backend_name = arg.substr(10);
+        } else if (arg.rfind("--onnx-dir=", 0) == 0) {
+            onnx_dir = arg.substr(11);
+        } else if (arg.rfind("--service-dist=", 0) == 0) {
+            if (!service_dist.parse(arg.substr(15))) {
+                std::cerr << "Invalid --service-dist (expected fixed, exp or lognormal[:cv])\n";
+                return 1;
+            }
+        } else if (arg == "--spin") {
+            spin = true;
+        } else if (arg == "--verbose") {
+            verbose = true;
+        } else if (arg.rfind("--service-ms=", 0) == 0) {
+            // Mean synthetic service time, also the admission prior
+            bool ok = parse_per_model(arg.substr(13), [](int model, double ms) {
+                for (int m = 0; m < oms::MODEL_COUNT; ++m)
+                    if (model < 0 || model == m) models[m].service_ms = ms;
+            });
+            if (!ok) {
+                std::cerr << "Invalid --service-ms (expected ms or model:ms[,model:ms...])\n";
+                return 1;
+            }
+        } else if (arg.rfind("--max-batch=", 0) == 0) {
+            max_batch = std::max(1, std::atoi(arg.c_str() + 12));
+        } else if (arg.rfind("--batch-wait-ms=", 0) == 0) {
+            batch_wait_ms = std::max(0, std::atoi(arg.c_str() + 16));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--models=resnet_50,yolov5s,retinaface,ssd]"
+                      << " [--backend=vitis|cpu|synthetic] [--onnx-dir=DIR]"
+                      << " [--service-dist=fixed|exp|lognormal[:cv]] [--spin] [--service-ms=[model:]MS,...]"
+                      << " [--share=none|fair] [--discipline=fifo|edf|sjf] [--weight=[model:]W,...]"
+                      << " [--device-share=none|fair] [--device-weight=[device:]W,...]"
+                      << " [--aqm=none|codel] [--codel-target-ms=MS] [--codel-interval-ms=MS]"
+                      << " [--decoders=N] [--instances=N] [--responders=N]"
+                      << " [--max-batch=B] [--batch-wait-ms=MS] [--wait-budget=[model:]MS,...] [--verbose]\n";
+            return 1;
+        }
+    }
+    if (!parse_models(hosted)) {
+        std::cerr << "Invalid --models: " << hosted << "\n";
+        return 1;
+    }
+    if (discipline == Discipline::SJF && share_policy != SharePolicy::NONE) {
+        std::cerr << "--discipline=sjf only orders models, use it with --share=none\n";
         return 1;
     }
 
+    std::unique_ptr<InferenceBackend> backend;
+    if (backend_name == "cpu") {
+        backend.reset(new OpenCvDnnBackend(onnx_dir));
+    } else if (backend_name == "synthetic") {
+        double service_ms[oms::MODEL_COUNT];
+        for (int m = 0; m < oms::MODEL_COUNT; ++m) service_ms[m] = models[m].service_ms;
+        backend.reset(new SyntheticBackend(service_ms, BATCH_EXTRA, service_dist, spin));
+#ifdef EC_HAVE_VITIS
+    } else if (backend_name == "vitis") {
+        backend.reset(new VitisBackend());
+#endif
+    } else {
+        std::cerr << "Unknown or unavailable --backend: " << backend_name << "\n";
+        return 1;
+    }
+
+    // Every accelerator worker gets an instance of every hosted model, plus
+    // enough input buffers for each worker to run a batch of a model while
+    // the next one is being decoded
+    int in_flight = num_instances * max_batch;
+    size_t decode_capacity = in_flight;
+    for (uint8_t m = 0; m < oms::MODEL_COUNT; ++m) {
+        HostedModel& hm = models[m];
+        hm.batch_ms.assign(max_batch + 1, 0);
+        for (int b = 1; b <= max_batch; ++b)
+            hm.batch_ms[b] = hm.service_ms * (1 + BATCH_EXTRA * (b - 1));
+        if (!hm.hosted) continue;
+        for (int w = 0; w < num_instances; ++w) {
+            hm.instances.push_back(backend->create(m));
+            if (!hm.instances.back()) {
+                std::cerr << "[EC] Failed to create " << oms::model_name(m) << " model instance on the "
+                          << backend->name() << " backend.\n";
+                return 1;
+            }
+        }
+        for (int i = 0; i < 2 * in_flight + num_decoders; ++i)
+            hm.free_inputs.push(cv::Mat(hm.instances[0]->input_height(), hm.instances[0]->input_width(), CV_8UC3));
+        decode_capacity += capacity_slots(m);
+    }
+    decode_queue.set_capacity(decode_capacity);
+    respond_queue.set_capacity(2 * in_flight);
+
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server_fd < 0) { perror("socket"); exit(EXIT_FAILURE); }
 
@@ -116,19 +1362,75 @@ int main() {
         perror("bind"); exit(EXIT_FAILURE);
     }
 
-    if (listen(server_fd, 20) < 0) {
+    if (listen(server_fd, SOMAXCONN) < 0) {
         perror("listen"); exit(EXIT_FAILURE);
     }
 
-    std::cout << "[EC] Listening on port " << PORT << "\n";
+    fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) | O_NONBLOCK);
+    epoll_fd = epoll_create1(0);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = server_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev);
 
+    decode_stats.workers = num_decoders;
+    infer_stats.workers = num_instances;
+    respond_stats.workers = num_responders;
+    for (int i = 0; i < num_decoders; ++i) std::thread(decode_loop).detach();
+    for (int w = 0; w < num_instances; ++w) std::thread(infer_loop, w).detach();
+    for (int i = 0; i < num_responders; ++i) std::thread(respond_loop).detach();
+    std::thread(occupancy_loop).detach();
+
+    std::cout << "[EC] Listening on port " << PORT << " hosting " << hosted << " on the " << backend->name() << " backend ("
+              << (share_policy == SharePolicy::NONE ? "no" : "fair") << " sharing, " << discipline_name(discipline)
+              << ", " << (device_share == DeviceShare::NONE ? "no" : "fair") << " device sharing"
+              << ") on " << num_instances
+              << " accelerator worker(s), batches of up to " << max_batch << " (wait " << batch_wait_ms << " ms)";
+    if (codel) std::cout << ", CoDel target " << codel_target_ms << " ms over " << codel_interval_ms << " ms";
+    std::cout << "\n";
+
+    std::unordered_map<int, std::shared_ptr<EdConn>> conns;
+    epoll_event events[64];
     while (true) {
-        sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        int new_socket = accept(server_fd, (sockaddr*)&client_addr, &client_len);
-        if (new_socket < 0) { perror("accept"); continue; }
+        int n = epoll_wait(epoll_fd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int e = 0; e < n; ++e) {
+            int fd = events[e].data.fd;
+            if (fd == server_fd) {
+                while (true) {
+                    int new_socket = accept4(server_fd, nullptr, nullptr, SOCK_NONBLOCK);
+                    if (new_socket < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("accept");
+                        break;
+                    }
+                    int one = 1;
+                    setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    conns[new_socket] = std::make_shared<EdConn>(new_socket);
+                    epoll_event cev{};
+                    cev.events = EPOLLIN;
+                    cev.data.fd = new_socket;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, new_socket, &cev);
+                }
+                continue;
+            }
 
-        std::thread(handle_request, new_socket).detach();
+            auto it = conns.find(fd);
+            if (it == conns.end()) continue;
+            std::shared_ptr<EdConn> conn = it->second;
+            bool alive = !(events[e].events & (EPOLLERR | EPOLLHUP));
+            if (alive && (events[e].events & EPOLLOUT)) conn->flush();
+            if (alive && (events[e].events & EPOLLIN)) alive = read_frames(conn);
+            if (!alive) {
+                // Queued tasks keep the EdConn (and its fd) alive until they finish
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+                release_conn(conn);
+                conns.erase(it);
+            }
+        }
     }
 
     return 0;
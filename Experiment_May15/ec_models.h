@@ -0,0 +1,297 @@
+// Models the EC can host, and the inference backends that run them.
+//
+// Each hosted model is one ModelRunner per accelerator worker, created by
+// the selected InferenceBackend from its oms::ModelId, so the pipeline can
+// route any request to any loaded model without knowing what executes it:
+//   vitis     - Vitis AI on the DPU, as deployed on the board
+//   cpu       - OpenCV DNN on ONNX exports, the network the ED helper runs
+//   synthetic - no network, batches take a configurable random service time
+// The last two let admission, batching and scheduling be exercised on any
+// Linux box. The Vitis backend is only compiled in where its headers exist.
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#if __has_include(<vitis/ai/classification.hpp>)
+#define EC_HAVE_VITIS 1
+#include <vitis/ai/classification.hpp>
+#include <vitis/ai/yolov3.hpp>
+#include <vitis/ai/retinaface.hpp>
+#include <vitis/ai/ssd.hpp>
+#endif
+#include "../dnn_preprocess.h"
+#include "../oms_protocol.h"
+
+class ModelRunner {
+public:
+    virtual ~ModelRunner() = default;
+    virtual int input_width() const = 0;
+    virtual int input_height() const = 0;
+    // Runs a batch of images already resized to the input size and returns
+    // one encoded MSG_DONE result (oms::ResultWriter) per image.
+    virtual std::vector<std::string> run(const std::vector<cv::Mat>& images) = 0;
+};
+
+class InferenceBackend {
+public:
+    virtual ~InferenceBackend() = default;
+    virtual const char* name() const = 0;
+    // Loads one instance of a model, nullptr if this backend cannot run it
+    // or loading failed.
+    virtual std::unique_ptr<ModelRunner> create(uint8_t model) = 0;
+};
+
+// Network input sizes of the deployed kernels, for backends that do not
+// get them from a loaded model.
+inline cv::Size model_input_size(uint8_t model) {
+    switch (model) {
+    case oms::MODEL_YOLOV5S:    return cv::Size(640, 640);
+    case oms::MODEL_RETINAFACE: return cv::Size(640, 360);
+    case oms::MODEL_SSD:        return cv::Size(480, 360);
+    default:                    return cv::Size(224, 224);
+    }
+}
+
+#ifdef EC_HAVE_VITIS
+// Adapts a Vitis AI model class; Encode writes one of its results as the
+// model's result records.
+template <typename Net, typename Encode>
+class VitisRunner : public ModelRunner {
+public:
+    VitisRunner(std::unique_ptr<Net> net, Encode encode) : net_(std::move(net)), encode_(encode) {}
+
+    int input_width() const override { return net_->getInputWidth(); }
+    int input_height() const override { return net_->getInputHeight(); }
+
+    std::vector<std::string> run(const std::vector<cv::Mat>& images) override {
+        auto results = net_->run(images);
+        std::vector<std::string> out(results.size());
+        for (size_t i = 0; i < results.size(); ++i) encode_(out[i], results[i]);
+        return out;
+    }
+
+private:
+    std::unique_ptr<Net> net_;
+    Encode encode_;
+};
+
+template <typename Net, typename Encode>
+std::unique_ptr<ModelRunner> make_vitis_runner(std::unique_ptr<Net> net, Encode encode) {
+    if (!net) return nullptr;
+    return std::unique_ptr<ModelRunner>(new VitisRunner<Net, Encode>(std::move(net), encode));
+}
+
+// Detection results of the YOLO and SSD kernels share their box fields
+template <typename Result>
+void encode_boxes(std::string& out, const Result& result) {
+    oms::ResultWriter writer(out, oms::RESULT_BOXES);
+    for (const auto& b : result.bboxes)
+        writer.add(oms::Box{static_cast<int32_t>(b.label), b.score, b.x, b.y, b.width, b.height});
+}
+
+// The kernel names are the ones the per-model EC binaries used.
+class VitisBackend : public InferenceBackend {
+public:
+    const char* name() const override { return "vitis"; }
+
+    std::unique_ptr<ModelRunner> create(uint8_t model) override {
+        switch (model) {
+        case oms::MODEL_RESNET50:
+            return make_vitis_runner(vitis::ai::Classification::create("resnet50"),
+                [](std::string& out, const vitis::ai::ClassificationResult& result) {
+                    oms::ResultWriter writer(out, oms::RESULT_CLASSES);
+                    for (const auto& r : result.scores)
+                        writer.add(oms::ClassScore{static_cast<uint32_t>(r.index), r.score});
+                });
+        case oms::MODEL_YOLOV5S:
+            return make_vitis_runner(vitis::ai::YOLOv3::create("yolov5s6_pt"),
+                encode_boxes<vitis::ai::YOLOv3Result>);
+        case oms::MODEL_RETINAFACE:
+            return make_vitis_runner(vitis::ai::RetinaFace::create("retinaface"),
+                [](std::string& out, const vitis::ai::RetinaFaceResult& result) {
+                    // One set of landmarks per detected face
+                    oms::ResultWriter writer(out, oms::RESULT_FACES);
+                    for (size_t i = 0; i < result.bboxes.size(); ++i) {
+                        const auto& b = result.bboxes[i];
+                        oms::Face face{b.score, b.x, b.y, b.width, b.height, {}};
+                        if (i < result.landmarks.size()) {
+                            for (int j = 0; j < oms::FACE_LANDMARKS; ++j) {
+                                face.landmarks[2 * j] = result.landmarks[i][j].first;
+                                face.landmarks[2 * j + 1] = result.landmarks[i][j].second;
+                            }
+                        }
+                        writer.add(face);
+                    }
+                });
+        case oms::MODEL_SSD:
+            return make_vitis_runner(vitis::ai::SSD::create("ssd_mobilenet_v2"),
+                encode_boxes<vitis::ai::SSDResult>);
+        default:
+            return nullptr;
+        }
+    }
+};
+#endif
+
+// ResNet-50 on the CPU through OpenCV DNN, with the ONNX export and
+// preprocessing of the ED's python helper. The other models have no ONNX
+// export yet.
+class DnnClassifier : public ModelRunner {
+public:
+    explicit DnnClassifier(cv::dnn::Net net) : net_(net) {
+        net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+        net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    }
+
+    int input_width() const override { return 224; }
+    int input_height() const override { return 224; }
+
+    std::vector<std::string> run(const std::vector<cv::Mat>& images) override {
+        net_.setInput(dnn_preprocess::imagenet_blob(images, cv::Size(224, 224)));
+        cv::Mat logits = net_.forward();  // one row of class scores per image
+        std::vector<std::string> out(images.size());
+        for (size_t i = 0; i < images.size() && static_cast<int>(i) < logits.rows; ++i)
+            encode_top5(out[i], logits.ptr<float>(i), logits.cols);
+        return out;
+    }
+
+private:
+    // Softmax scores of the five best classes, as the Vitis AI classifier
+    // reports them
+    static void encode_top5(std::string& out, const float* logits, int classes) {
+        std::vector<int> order(classes);
+        for (int c = 0; c < classes; ++c) order[c] = c;
+        int k = std::min(5, classes);
+        std::partial_sort(order.begin(), order.begin() + k, order.end(),
+                          [logits](int a, int b) { return logits[a] > logits[b]; });
+        double sum = 0;
+        for (int c = 0; c < classes; ++c) sum += std::exp(logits[c] - logits[order[0]]);
+        oms::ResultWriter writer(out, oms::RESULT_CLASSES);
+        for (int j = 0; j < k; ++j) {
+            int c = order[j];
+            writer.add(oms::ClassScore{static_cast<uint32_t>(c), static_cast<float>(std::exp(logits[c] - logits[order[0]]) / sum)});
+        }
+    }
+
+    cv::dnn::Net net_;
+};
+
+class OpenCvDnnBackend : public InferenceBackend {
+public:
+    // dir holds resnet50.onnx
+    explicit OpenCvDnnBackend(std::string dir) : dir_(std::move(dir)) {}
+
+    const char* name() const override { return "cpu"; }
+
+    std::unique_ptr<ModelRunner> create(uint8_t model) override {
+        if (model != oms::MODEL_RESNET50) return nullptr;
+        cv::dnn::Net net;
+        try {
+            net = cv::dnn::readNetFromONNX(dir_ + "/resnet50.onnx");
+        } catch (const cv::Exception&) {
+            return nullptr;
+        }
+        if (net.empty()) return nullptr;
+        return std::unique_ptr<ModelRunner>(new DnnClassifier(net));
+    }
+
+private:
+    std::string dir_;
+};
+
+// Service time of a synthetic batch
+//   fixed:     always the mean
+//   exp:       exponential with the given mean
+//   lognormal: lognormal with the given mean and coefficient of variation
+struct ServiceDist {
+    enum Kind { FIXED, EXP, LOGNORMAL } kind = FIXED;
+    double cv = 0.3;       // lognormal only
+
+    // Parses "fixed", "exp" or "lognormal[:cv]"
+    bool parse(const std::string& spec) {
+        std::string name = spec.substr(0, spec.find(':'));
+        if (name == "fixed") kind = FIXED;
+        else if (name == "exp") kind = EXP;
+        else if (name == "lognormal") kind = LOGNORMAL;
+        else return false;
+        if (spec.find(':') != std::string::npos) cv = std::atof(spec.c_str() + spec.find(':') + 1);
+        return cv > 0;
+    }
+
+    const char* name() const { return kind == FIXED ? "fixed" : kind == EXP ? "exp" : "lognormal"; }
+};
+
+class SyntheticRunner : public ModelRunner {
+public:
+    SyntheticRunner(cv::Size input, double mean_ms, double batch_extra, ServiceDist dist, bool spin)
+        : input_(input), mean_ms_(mean_ms), batch_extra_(batch_extra), dist_(dist), spin_(spin),
+          rng_(std::random_device{}()) {}
+
+    int input_width() const override { return input_.width; }
+    int input_height() const override { return input_.height; }
+
+    // A batch of n costs (1 + batch_extra * (n - 1)) times one image, the
+    // shape the EC's admission prior assumes for the DPU
+    std::vector<std::string> run(const std::vector<cv::Mat>& images) override {
+        double ms = sample(mean_ms_ * (1 + batch_extra_ * (images.size() - 1)));
+        auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<int64_t>(ms * 1000));
+        if (spin_) {
+            while (std::chrono::steady_clock::now() < until) {}
+        } else {
+            std::this_thread::sleep_until(until);
+        }
+        std::vector<std::string> out(images.size());
+        for (auto& result : out) oms::ResultWriter(result, oms::RESULT_NONE);
+        return out;
+    }
+
+private:
+    double sample(double mean) {
+        switch (dist_.kind) {
+        case ServiceDist::EXP:
+            return std::exponential_distribution<double>(1 / mean)(rng_);
+        case ServiceDist::LOGNORMAL: {
+            double s2 = std::log(1 + dist_.cv * dist_.cv);
+            return std::lognormal_distribution<double>(std::log(mean) - s2 / 2, std::sqrt(s2))(rng_);
+        }
+        default:
+            return mean;
+        }
+    }
+
+    cv::Size input_;
+    double mean_ms_;
+    double batch_extra_;
+    ServiceDist dist_;
+    bool spin_;
+    std::mt19937 rng_;
+};
+
+// Stands in for any model. spin busy-waits instead of sleeping, to model a
+// backend that occupies a CPU core.
+class SyntheticBackend : public InferenceBackend {
+public:
+    SyntheticBackend(const double* mean_ms, double batch_extra, ServiceDist dist, bool spin)
+        : mean_ms_(mean_ms, mean_ms + oms::MODEL_COUNT), batch_extra_(batch_extra), dist_(dist), spin_(spin) {}
+
+    const char* name() const override { return "synthetic"; }
+
+    std::unique_ptr<ModelRunner> create(uint8_t model) override {
+        if (model >= oms::MODEL_COUNT) return nullptr;
+        return std::unique_ptr<ModelRunner>(
+            new SyntheticRunner(model_input_size(model), mean_ms_[model], batch_extra_, dist_, spin_));
+    }
+
+private:
+    std::vector<double> mean_ms_;
+    double batch_extra_;
+    ServiceDist dist_;
+    bool spin_;
+};
@@ -0,0 +1,92 @@
+// Recycled receive buffers.
+//
+// Image payloads are received straight into buffers taken from power-of-two
+// size classes (4 KB .. 16 MB) and handed back when the task is done, so a
+// steady stream of uploads does not allocate. Payloads above the largest
+// class get a one-off allocation. Buffers may be released from any thread.
+#pragma once
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+
+class BufferPool {
+public:
+    static const int MIN_SHIFT = 12;       // 4 KB
+    static const int MAX_SHIFT = 24;       // 16 MB
+    static const size_t MAX_FREE = 64;     // idle buffers kept per class
+
+    // Move-only handle; returns its storage to the pool when destroyed.
+    class Buffer {
+    public:
+        Buffer() = default;
+        Buffer(Buffer&& other) noexcept { *this = std::move(other); }
+        Buffer& operator=(Buffer&& other) noexcept {
+            if (this != &other) {
+                release();
+                pool_ = other.pool_;
+                cls_ = other.cls_;
+                data_ = std::move(other.data_);
+                size_ = other.size_;
+                other.pool_ = nullptr;
+                other.size_ = 0;
+            }
+            return *this;
+        }
+        ~Buffer() { release(); }
+
+        char* data() { return data_.get(); }
+        const char* data() const { return data_.get(); }
+        size_t size() const { return size_; }
+
+    private:
+        friend class BufferPool;
+        void release() {
+            if (pool_ && data_) pool_->put(cls_, std::move(data_));
+            pool_ = nullptr;
+            data_.reset();
+            size_ = 0;
+        }
+
+        BufferPool* pool_ = nullptr;
+        int cls_ = -1;  // -1: not pooled
+        std::unique_ptr<char[]> data_;
+        size_t size_ = 0;
+    };
+
+    Buffer acquire(size_t size) {
+        Buffer buf;
+        buf.size_ = size;
+        if (size == 0) return buf;
+        int cls = size_class(size);
+        buf.pool_ = this;
+        buf.cls_ = cls;
+        if (cls >= 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& free = free_[cls];
+            if (!free.empty()) {
+                buf.data_ = std::move(free.back());
+                free.pop_back();
+                return buf;
+            }
+        }
+        buf.data_.reset(new char[cls >= 0 ? size_t(1) << (cls + MIN_SHIFT) : size]);
+        return buf;
+    }
+
+private:
+    static int size_class(size_t size) {
+        for (int shift = MIN_SHIFT; shift <= MAX_SHIFT; ++shift)
+            if (size <= (size_t(1) << shift)) return shift - MIN_SHIFT;
+        return -1;
+    }
+
+    void put(int cls, std::unique_ptr<char[]> data) {
+        if (cls < 0) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_[cls].size() < MAX_FREE) free_[cls].push_back(std::move(data));
+    }
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<char[]>> free_[MAX_SHIFT - MIN_SHIFT + 1];
+};
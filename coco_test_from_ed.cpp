@@ -9,6 +9,7 @@
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <cstring>
+#include "buffer_pool.h"
 
 const int PORT = 5000;
 
@@ -39,6 +40,7 @@ int main() {
 
     std::cout << "[EC] Listening on port " << PORT << "..." << std::endl;
     int received_images = 0;
+    BufferPool pool;  // one buffer per size class is reused for every upload
 
     while (true) {
         int new_socket = accept(server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen);
@@ -56,17 +58,20 @@ int main() {
         }
 
         uint32_t img_size = ntohl(net_size);
-        std::vector<char> buffer(img_size);
+        auto start = std::chrono::steady_clock::now();
+        BufferPool::Buffer buffer = pool.acquire(img_size);
         size_t total_received = 0;
         while (total_received < img_size) {
             int chunk = recv(new_socket, buffer.data() + total_received, img_size - total_received, 0);
             if (chunk <= 0) break;
             total_received += chunk;
         }
+        double recv_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
         if (total_received == img_size) {
             received_images++;
-            std::cout << "[EC] Received image " << received_images << " (" << img_size << " bytes)" << std::endl;
+            std::cout << "[EC] Received image " << received_images << " (" << img_size << " bytes in "
+                      << recv_ms << " ms)" << std::endl;
         } else {
             std::cerr << "[EC] Incomplete image received." << std::endl;
         }
@@ -0,0 +1,26 @@
+// Network input preparation shared by the EC's OpenCV DNN backend and the
+// ED's native fallback, so both feed an ONNX export the same tensor.
+#pragma once
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace dnn_preprocess {
+
+// NCHW blob of the BGR images resized to size, in RGB and normalized the
+// way torchvision's ImageNet models expect: (x / 255 - mean) / std per
+// channel. blobFromImages subtracts its mean before scaling and has no std,
+// so it only scales here and the planes are normalized afterwards.
+inline cv::Mat imagenet_blob(const std::vector<cv::Mat>& images, cv::Size size) {
+    static const double mean[3] = {0.485, 0.456, 0.406};
+    static const double stddev[3] = {0.229, 0.224, 0.225};
+    cv::Mat blob = cv::dnn::blobFromImages(images, 1.0 / 255, size, cv::Scalar(), true, false);
+    for (int n = 0; n < static_cast<int>(images.size()); ++n) {
+        for (int c = 0; c < 3; ++c) {
+            cv::Mat plane(size, CV_32F, blob.ptr<float>(n, c));
+            plane.convertTo(plane, CV_32F, 1.0 / stddev[c], -mean[c] / stddev[c]);
+        }
+    }
+    return blob;
+}
+
+}  // namespace dnn_preprocess
@@ -1,40 +1,160 @@
 // C++ CODE (Updated to include full end-to-end average inference time)
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <thread>
 #include <chrono>
 #include <random>
 #include <cstring>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 #include <cstdlib>
 #include <vector>
 #include <mutex>
 #include <queue>
+#include <deque>
 #include <condition_variable>
 #include <atomic>
 #include <cstdio>
+#include <cerrno>
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <unordered_map>
 #include <algorithm>
-#include <dirent.h>
+#include <cmath>
+#include <memory>
+#include "oms_protocol.h"
+#include "image_catalog.h"
+#include "local_fallback.h"
+#include "shm_channel.h"
+#include "steal_queue.h"
+#include <pthread.h>
+#include <sched.h>
 
 const char* EC_IP   = "192.168.0.100";
 const int   PORT    = 5000;
 const char* IMAGE   = "000000006321.jpg";
-const char* PY_CMD  = "python3 rn50_local_run_measure_correct.py";
+const char* IMAGE_DIR = "COCO_test_1220";
+const char* PY_CMD  = "python3";
+const int   EC_CONNS  = 4;   // pipelined connections driven by the offload engine
+
+oms::ModelId model_id = oms::MODEL_RESNET50;
+oms::DeviceId device_id = oms::DEVICE_PI5;  // tag the EC shares its capacity by
+
+enum class EagerMode { OFF, ON, AUTO };
+EagerMode eager_mode = EagerMode::AUTO;
+double link_mbps = 100.0;  // ED -> EC uplink, used to price a wasted eager upload
+bool use_credits = true;
+
+// Where fallback tasks run (--local)
+//   native: in process, OpenCV DNN on an ONNX export (needs OpenCV at build time)
+//   python: the helper, "token:path" lines on its stdin, done lines on a FIFO
+//   shm:    the helper, image bytes and descriptors through shared memory
+enum class LocalMode { NATIVE, PYTHON, SHM };
+// native and shm run a pool of persistent workers, each pinned to its own
+// cores; python has a single helper
+int local_workers = 0;   // --local-workers, 0 = cores / local_threads
+int local_threads = 1;   // --local-threads, intra-op threads of each worker
+const int CREDIT_PROBE_EVERY = 32;  // without credits, still ask the EC this often
+const int SUPPRESS_PROBE_EVERY = 16;  // inside a retry-after window, probe this often
+const int LOCAL_INFLIGHT_MAX = 1;     // the FIFO helper takes one image at a time
+double hedge_margin = 0;              // --hedge, 0 = never run a task on both sides
+
+// Per-model latency SLO in ms (--slo), 0 = no deadline
+uint32_t slo_ms[oms::MODEL_COUNT] = {};
+const auto NO_DEADLINE = std::chrono::steady_clock::time_point::max();
 
 std::mutex stats_mutex;
 int completed_tasks    = 0;
 int ran_on_ed          = 0;
 int sent_to_ec         = 0;
 long total_latency_ms  = 0;
+int eager_sent         = 0;
+int eager_dropped      = 0;
+long eager_wasted_bytes = 0;
+int credit_spent       = 0;
+int credit_local       = 0;   // run locally without asking the EC
+int suppressed_local   = 0;   // run locally inside a DROP retry-after window
+int expired_local      = 0;   // skipped by the local dispatcher, deadline passed
+int failed_local       = 0;   // local runs that ended without a result
+int hedged_started     = 0;
+int hedge_local_won    = 0;   // the hedge paid off: local copy beat the EC
+int hedge_ec_won       = 0;
+long ec_result_bytes   = 0;   // MSG_DONE payloads of offloaded tasks
+int ec_bad_results     = 0;   // payloads too short for the records they announce
+double local_service_ms = -1; // EWMA of local inference time, guarded by stats_mutex
+
+// Tasks running both on the EC and locally. The first side to finish claims
+// the task and cancels the other; the entry stays until the other side is
+// accounted for as well (cancelled, failed or reported), so it cannot claim
+// the task too.
+enum class HedgeState {
+    RACING,        // both copies outstanding
+    LOCAL_WON,     // the EC copy may still report
+    EC_WON,        // the local copy may still report
+    LOCAL_FAILED,  // the local copy expired, the EC copy is all that is left
+    EC_FAILED,     // the EC dropped its copy, the local one is all that is left
+};
+std::mutex hedge_mutex;
+std::unordered_map<int, HedgeState> hedged_tasks;
+
+enum class Claim {
+    SOLE,  // not hedged, or the other copy failed: an ordinary result
+    WON,   // won the race, the caller cancels the other copy
+    LOST,  // the other copy won, discard this result
+};
+
+// One side of a task finished with a result
+Claim claim_task(int token, bool local) {
+    std::lock_guard<std::mutex> lock(hedge_mutex);
+    auto it = hedged_tasks.find(token);
+    if (it == hedged_tasks.end()) return Claim::SOLE;
+    HedgeState state = it->second;
+    if (state == HedgeState::RACING) {
+        it->second = local ? HedgeState::LOCAL_WON : HedgeState::EC_WON;
+        return Claim::WON;
+    }
+    hedged_tasks.erase(it);
+    return state == (local ? HedgeState::EC_FAILED : HedgeState::LOCAL_FAILED) ? Claim::SOLE : Claim::LOST;
+}
+
+// One side of a hedged task ended without a result. Returns true if the
+// other copy is still outstanding.
+bool hedge_side_failed(int token, bool local) {
+    std::lock_guard<std::mutex> lock(hedge_mutex);
+    auto it = hedged_tasks.find(token);
+    if (it == hedged_tasks.end()) return false;
+    if (it->second == HedgeState::RACING) {
+        it->second = local ? HedgeState::LOCAL_FAILED : HedgeState::EC_FAILED;
+        return true;
+    }
+    hedged_tasks.erase(it);
+    return false;
+}
+
+// The winner cancelled the losing copy before it reported
+void hedge_settled(int token) {
+    std::lock_guard<std::mutex> lock(hedge_mutex);
+    hedged_tasks.erase(token);
+}
+
+struct LocalTask {
+    int token;
+    size_t image;  // catalog index
+    std::chrono::steady_clock::time_point deadline;
+};
+
+StealQueue<LocalTask> local_tasks;  // one deque per local worker, sized in main
 
 std::mutex queue_mutex;
 std::condition_variable queue_cv;
-std::queue<std::string> local_queue;
-bool stop_local = false;
+int local_inflight = 0;     // taken by a local worker, not yet reported done
+bool helper_gone = false;   // the FIFO helper closed the notify FIFO
+std::atomic<int> shm_helpers{0};  // --local=shm workers whose helper still runs
 
 std::unordered_map<int, double> local_infer_time_ms;
 std::unordered_map<int, long> task_start_time;
@@ -52,24 +172,22 @@ void log_result(const std::string& entry) {
     log << entry << std::endl;
 }
 
-std::string get_random_image_from_coco() {
-    std::vector<std::string> images;
-    const char* dir_path = "COCO_test_1220";
-    DIR* dir = opendir(dir_path);
-    if (!dir) return IMAGE;
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr)
-        if (entry->d_type == DT_REG)
-            images.emplace_back(std::string(dir_path) + "/" + entry->d_name);
-    closedir(dir);
-    if (images.empty()) return IMAGE;
-    std::mt19937 gen(std::random_device{}());
-    std::uniform_int_distribution<> dist(0, images.size() - 1);
-    return images[dist(gen)];
+// Workload images, preloaded before the generator starts
+ImageCatalog catalog;
+
+// Python fallback helper of each model for --local=python and --local=shm;
+// both modes are implemented by these scripts. nullptr if there is none.
+const char* helper_script(uint8_t model) {
+    switch (model) {
+    case oms::MODEL_RESNET50: return "rn50_local_run_serial_bwaj.py";
+    case oms::MODEL_YOLOV5S:  return "yolov5s_local_run_serial_bwaj.py";
+    default:                  return nullptr;
+    }
 }
 
-FILE* start_python_helper(int duration_sec) {
-    std::string py_cmd = std::string(PY_CMD) + " " + std::to_string(duration_sec);
+// The helper inherits the calling thread's CPU affinity
+FILE* start_python_helper(int duration_sec, const std::string& extra_args = "", const std::string& env = "") {
+    std::string py_cmd = env + PY_CMD + " " + helper_script(model_id) + " " + std::to_string(duration_sec) + extra_args;
     FILE* py = popen(py_cmd.c_str(), "w");
     if (!py) {
         std::cerr << "[ED] Failed to launch python fallback\n";
@@ -78,28 +196,224 @@ FILE* start_python_helper(int duration_sec) {
     return py;
 }
 
-void enqueue_local_run(int token_ed, const std::string& image_path) {
-    std::string task_info = std::to_string(token_ed) + ":" + image_path;
+// Removes a hedged task's local copy if no local worker has picked it up
+// yet; false if it is already running.
+bool cancel_local_run(int token_ed) {
+    return local_tasks.remove_if([&](const LocalTask& t) { return t.token == token_ed; });
+}
+
+// Expected completion time of a task queued locally now, with the backlog
+// spread over the workers. Before any local timing is known this is 0 while
+// a worker is idle (a free local run is worth taking to learn its speed)
+// and -1 otherwise.
+double predict_local_ms() {
+    double service;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        service = local_service_ms;
+    }
+    size_t workers = local_tasks.workers();
+    size_t backlog = local_tasks.size();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        backlog += local_inflight;
+    }
+    if (service < 0) return backlog < workers ? 0 : -1;
+    return ((backlog + workers) / workers) * service;
+}
+
+// Pins the calling local worker to local_threads cores of its own, wrapping
+// around when there are more workers than that
+void pin_local_worker(size_t worker) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int t = 0; t < local_threads; ++t) CPU_SET((worker * local_threads + t) % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+void cancel_offload(int token_ed);
+
+void enqueue_local_run(int token_ed, size_t image, std::chrono::steady_clock::time_point deadline) {
+    local_tasks.push({token_ed, image, deadline});
+}
+
+// Next task for local worker `worker`. Workers only take a task when they
+// can start it, so the backlog stays in local_tasks, where it can still be
+// stolen by an idle worker or skipped once its deadline has passed instead
+// of sitting unseen in a pipe buffer. Returns false once the worker should
+// stop.
+bool next_local_task(size_t worker, LocalTask& task) {
+    while (local_tasks.pop(worker, task)) {
+        if (std::chrono::steady_clock::now() > task.deadline) {
+            {
+                std::lock_guard<std::mutex> stats_lock(stats_mutex);
+                expired_local++;
+            }
+            log_result("[ED_EXPIRED] token_ed=" + std::to_string(task.token));
+            hedge_side_failed(task.token, true);
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        local_inflight++;
+        return true;
+    }
+    return false;
+}
+
+// Completion of a local run, from any runner
+void local_run_done(int token, double infer_time_ms, long done_time) {
     {
         std::lock_guard<std::mutex> lock(queue_mutex);
-        local_queue.push(task_info);
+        local_inflight--;
     }
     queue_cv.notify_one();
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        local_service_ms = local_service_ms < 0 ? infer_time_ms : 0.9 * local_service_ms + 0.1 * infer_time_ms;
+    }
+    Claim claim = claim_task(token, true);
+    if (claim == Claim::LOST) {
+        log_result("[ED_HEDGE_LOST] token_ed=" + std::to_string(token) + " local");
+        return;
+    }
+    if (claim == Claim::WON) cancel_offload(token);
+    {
+        // Counted here rather than when queued, so expired and failed runs
+        // are not; a hedged copy outliving an EC DROP is no win
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        completed_tasks++;
+        ran_on_ed++;
+        if (claim == Claim::WON) hedge_local_won++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(time_map_mutex);
+        local_infer_time_ms[token] = infer_time_ms;
+        task_end_time[token] = done_time;  // Mark task death time
+    }
+    log_result("[ED_DONE] token_ed=" + std::to_string(token) + " infer_time=" + std::to_string(infer_time_ms) + " ms");
 }
 
+// A local run that ended without a result. Frees its runner like
+// local_run_done but leaves the timing and the EWMA alone; a hedged task's
+// EC copy becomes the only one. token is -1 when the helper could not tell
+// which task failed.
+void local_run_failed(int token) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        local_inflight--;
+    }
+    queue_cv.notify_one();
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        failed_local++;
+    }
+    if (token < 0) {
+        log_result("[ED_LOCAL_FAILED] token_ed=unknown");
+        return;
+    }
+    hedge_side_failed(token, true);
+    log_result("[ED_LOCAL_FAILED] token_ed=" + std::to_string(token));
+}
+
+// --local=python: the helper reads "token:path" lines on stdin and reports
+// back through start_done_listener, up to LOCAL_INFLIGHT_MAX at a time
 void local_run_dispatch(FILE* py) {
+    LocalTask task;
     while (true) {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        queue_cv.wait(lock, [] { return !local_queue.empty() || stop_local; });
-        if (stop_local && local_queue.empty()) break;
-        std::string task = local_queue.front();
-        local_queue.pop();
-        lock.unlock();
-        fprintf(py, "%s\n", task.c_str());
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [] { return helper_gone || local_inflight < LOCAL_INFLIGHT_MAX; });
+            if (helper_gone) break;
+        }
+        if (!next_local_task(0, task)) break;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (helper_gone) break;
+        }
+        fprintf(py, "%d:%s\n", task.token, catalog.entry(task.image).path.c_str());
         fflush(py);
     }
 }
 
+// --local=shm: worker `worker` starts its own helper from this pinned thread,
+// so the helper runs on the worker's cores, and hands it one task at a time,
+// the image copied into the channel's slot
+void shm_worker(size_t worker, int duration_sec, uint32_t slot_size) {
+    pin_local_worker(worker);
+    shm::Channel channel;
+    std::string name = "/oms_fallback_" + std::to_string(getpid()) + "_" + std::to_string(worker);
+    if (!channel.create(name, 1, slot_size)) {
+        perror("[ED] shared memory channel");
+        shm_helpers--;
+        return;
+    }
+    FILE* py = start_python_helper(duration_sec, " --shm=" + channel.spec(),
+                                   "OMP_NUM_THREADS=" + std::to_string(local_threads) + " ");
+    channel.watch(fileno(py));
+    LocalTask task;
+    shm::DoneDesc done;
+    bool helper_running = true;
+    while (next_local_task(worker, task)) {
+        if (!helper_running) {
+            local_run_failed(task.token);
+            continue;
+        }
+        const ImageCatalog::Entry& img = catalog.entry(task.image);
+        if (!channel.submit(task.token, catalog.data(task.image), img.size)) {
+            std::cerr << "[ED] Cannot hand " << img.path << " to helper " << worker << "\n";
+            local_run_failed(task.token);
+            continue;
+        }
+        if (!channel.wait_done(done)) {
+            // The helper exited (time limit or crash) with the task in flight.
+            // While other helpers run, the task goes back to them along with
+            // whatever they steal from this worker's deque; the last worker
+            // without a helper fails the rest so that none go uncounted.
+            helper_running = false;
+            if (--shm_helpers > 0) {
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    local_inflight--;
+                }
+                local_tasks.push(task);
+                log_result("[ED_REQUEUED] token_ed=" + std::to_string(task.token));
+                break;
+            }
+            local_run_failed(task.token);
+            continue;
+        }
+        if (done.status) {
+            std::cerr << "[ED] Helper could not run token_ed=" << done.token << "\n";
+            local_run_failed(done.token);
+            continue;
+        }
+        local_run_done(done.token, done.infer_us / 1000.0, static_cast<long>(done.done_ms));
+    }
+    channel.close_tasks();
+    while (channel.wait_done(done)) {}
+    pclose(py);
+}
+
+#ifdef ED_HAVE_OPENCV
+// --local=native: worker `worker` runs each task on its own model instance
+// from the catalog's copy of the image and reports it done directly
+void native_worker(size_t worker, LocalFallback* fallback) {
+    pin_local_worker(worker);
+    LocalTask task;
+    while (next_local_task(worker, task)) {
+        auto start = std::chrono::steady_clock::now();
+        if (!fallback->run(catalog.data(task.image), catalog.entry(task.image).size)) {
+            std::cerr << "[ED] Cannot run the fallback on " << catalog.entry(task.image).path << "\n";
+            local_run_failed(task.token);
+            continue;
+        }
+        double infer_time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        local_run_done(task.token, infer_time_ms, current_time_ms());
+    }
+}
+#endif
+
 void start_done_listener() {
     const char* fifo_path = "fallback_notify.fifo";
     mkfifo(fifo_path, 0666);
@@ -118,113 +432,772 @@ void start_done_listener() {
         int token = std::stoi(line.substr(0, first));
         double infer_time_ms = std::stod(line.substr(first + 1, second - first - 1));
         long done_time = std::stol(line.substr(second + 1));
-        {
-            std::lock_guard<std::mutex> lock(time_map_mutex);
-            local_infer_time_ms[token] = infer_time_ms;
-            task_end_time[token] = done_time;  // Mark task death time
-        }
-        log_result("[ED_DONE] token_ed=" + std::to_string(token) + " infer_time=" + std::to_string(infer_time_ms) + " ms");
+        // Optional fourth field: non-zero when the helper could not run the task
+        auto third = line.find(',', second + 1);
+        if (third != std::string::npos && std::stoi(line.substr(third + 1)) != 0)
+            local_run_failed(token);
+        else
+            local_run_done(token, infer_time_ms, done_time);
     }
     fclose(fifo);
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        helper_gone = true;
+    }
+    queue_cv.notify_one();
+    local_tasks.close();  // wakes a dispatcher waiting for work
 }
 
-void run_request(int token_ed) {
-    task_start_time[token_ed] = current_time_ms();  // Mark task birth
+// One-line digest of an EC result for the task log: the top class, or how
+// many boxes or faces were found and the best score among them
+std::string describe_result(const oms::ResultView& result) {
+    std::ostringstream text;
+    switch (result.kind()) {
+    case oms::RESULT_CLASSES:
+        if (result.count() == 0) return "no classes";
+        text << "class=" << result.class_score(0).id << " score=" << result.class_score(0).score;
+        return text.str();
+    case oms::RESULT_BOXES:
+    case oms::RESULT_FACES: {
+        bool boxes = result.kind() == oms::RESULT_BOXES;
+        float best = 0;
+        for (size_t i = 0; i < result.count(); ++i)
+            best = std::max(best, boxes ? result.box(i).score : result.face(i).score);
+        text << result.count() << (boxes ? " boxes" : " faces");
+        if (result.count()) text << " best=" << best;
+        return text.str();
+    }
+    default:
+        return "none";
+    }
+}
 
-    auto start = std::chrono::high_resolution_clock::now();
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-        perror("[ED] socket failed");
-        enqueue_local_run(token_ed, get_random_image_from_coco());
-        return;
+void record_offload(int token_ed, uint32_t token_ec, long duration, const oms::ResultView& result) {
+    long now_ms = current_time_ms();
+    {
+        std::lock_guard<std::mutex> lock(time_map_mutex);
+        task_end_time[token_ed] = now_ms;  // Mark task death time
     }
-    sockaddr_in serv_addr{};
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(PORT);
-    inet_pton(AF_INET, EC_IP, &serv_addr.sin_addr);
-    if (connect(sock, (sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
-        perror("[ED] connect failed");
-        close(sock);
-        enqueue_local_run(token_ed, get_random_image_from_coco());
-        return;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        completed_tasks++;
+        total_latency_ms += duration;
+        sent_to_ec++;
+        if (result.valid()) ec_result_bytes += oms::RESULT_HEADER_SIZE + result.count() * oms::result_record_size(result.kind());
+        else ec_bad_results++;
     }
-    std::string req = "REQ:" + std::to_string(token_ed) + ":resnet_50:PI5";
-    send(sock, req.c_str(), req.size(), 0);
-    char buf[256] = {0};
-    int received = recv(sock, buf, sizeof(buf) - 1, 0);
-    if (received <= 0) {
-        close(sock);
-        enqueue_local_run(token_ed, get_random_image_from_coco());
-        return;
+    log_result("[ED_SENT] token_ed=" + std::to_string(token_ed) + " token_ec=" + std::to_string(token_ec) + " duration=" + std::to_string(duration) + " ms"
+               + " result=" + (result.valid() ? describe_result(result) : "malformed"));
+}
+
+void run_locally(int token_ed, size_t image, std::chrono::steady_clock::time_point deadline) {
+    enqueue_local_run(token_ed, image, deadline);
+    log_result("[ED_FALLBACK] token_ed=" + std::to_string(token_ed) + " fallback");
+}
+
+// Drives every offload through REQ -> GRANT -> DATA -> DONE on one epoll
+// thread. Sockets are non-blocking and pipelined, so the number of tasks in
+// flight is bounded by what the EC admits rather than by an ED thread count.
+// Eager (0-RTT) tasks skip the GRANT step by sending the image with the REQ.
+// With credits the EC pre-approves admissions per connection, so a credited
+// task is sent eagerly with no admission check, and a task that finds no
+// credit goes straight to the local fallback (apart from periodic probes).
+// A DROP's retry-after hint likewise keeps uncredited tasks local until the
+// EC expects to have room again. Each frame carries the task's remaining
+// deadline budget so the EC can reject work it cannot finish in time.
+// With --hedge, a task whose predicted EC and local latencies are within the
+// margin also gets a local copy; whichever side finishes first wins and the
+// other is cancelled.
+class OffloadEngine {
+public:
+    bool start() {
+        epoll_fd_ = epoll_create1(0);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK);
+        if (epoll_fd_ < 0 || wake_fd_ < 0) return false;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = WAKE_ID;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+        thread_ = std::thread(&OffloadEngine::loop, this);
+        return true;
     }
-    std::string response(buf, received);
-    if (response.rfind("GRANT:", 0) == 0) {
-        std::string token_ec = response.substr(6);
-        std::string ok_msg = "OK:" + token_ec + ":" + std::to_string(token_ed);
-        send(sock, ok_msg.c_str(), ok_msg.size(), 0);
-        std::ifstream file(IMAGE, std::ios::binary);
-        if (!file) {
-            close(sock);
+
+    // Thread-safe; called by the generator.
+    void submit(int token_ed, size_t image) {
+        {
+            std::lock_guard<std::mutex> lock(submit_mutex_);
+            auto now = std::chrono::steady_clock::now();
+            auto deadline = slo_ms[model_id] ? now + std::chrono::milliseconds(slo_ms[model_id]) : NO_DEADLINE;
+            submitted_.push_back({token_ed, image, now, 0, false, now, deadline, false});
+        }
+        wake();
+    }
+
+    // Thread-safe; drops a hedged task from the EC side after the local copy
+    // won. A no-op once finish() returned: nothing is in flight any more.
+    void cancel(int token_ed) {
+        std::lock_guard<std::mutex> lock(submit_mutex_);
+        if (stopped_) {
+            hedge_settled(token_ed);
             return;
         }
-        char img_buf[4096];
-        while (file.read(img_buf, sizeof(img_buf)))
-            send(sock, img_buf, file.gcount(), 0);
-        if (file.gcount() > 0)
-            send(sock, img_buf, file.gcount(), 0);
-        file.close();
-        shutdown(sock, SHUT_WR);
-        char done_buf[16] = {0};
-        int bytes = recv(sock, done_buf, sizeof(done_buf) - 1, 0);
-        if (bytes <= 0) {
-            close(sock);
+        cancels_.push_back(token_ed);
+        wake();
+    }
+
+    // Returns once every submitted task has finished on the EC or fallen back.
+    void finish() {
+        stopping_ = true;
+        wake();
+        thread_.join();
+        for (auto& conn : conns_)
+            if (conn.fd >= 0) close(conn.fd);
+        // Local workers still running hedged copies may call cancel()
+        std::lock_guard<std::mutex> lock(submit_mutex_);
+        stopped_ = true;
+        close(wake_fd_);
+        close(epoll_fd_);
+        wake_fd_ = epoll_fd_ = -1;
+    }
+
+private:
+    static const uint64_t WAKE_ID = ~0ull;
+
+    struct Task {
+        int token;
+        size_t image;
+        std::chrono::steady_clock::time_point start;
+        uint32_t token_ec;
+        bool eager;
+        std::chrono::steady_clock::time_point sent;
+        std::chrono::steady_clock::time_point deadline;
+        bool hedged;
+    };
+
+    // Per-model link estimates for the eager decision, engine thread only
+    struct LinkStats {
+        double rtt_ms = -1;    // REQ -> GRANT/DROP turnaround, EWMA
+        double accept = 1.0;   // fraction of requests admitted, EWMA
+        unsigned lazy_count = 0;
+        std::chrono::steady_clock::time_point suppress_until;  // from DROP retry-after
+        unsigned suppressed = 0;
+        double ec_latency_ms = -1;  // submit -> DONE, EWMA
+    };
+
+    // Header plus an optional range of the catalog arena sent with sendfile.
+    struct OutFrame {
+        char head[oms::HEADER_SIZE];
+        size_t head_sent = 0;
+        off_t file_off = 0;
+        uint32_t file_len = 0;
+        uint32_t file_sent = 0;
+    };
+
+    struct Conn {
+        int fd = -1;
+        bool connecting = false;
+        uint32_t events = 0;
+        std::vector<char> in;
+        std::deque<OutFrame> out;
+        std::unordered_map<uint32_t, Task> inflight;
+        int credits = 0;
+        bool credit_known = false;  // first MSG_CREDIT received
+    };
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t n = write(wake_fd_, &one, sizeof(one));
+        (void)n;
+    }
+
+    void loop() {
+        epoll_event events[64];
+        while (true) {
+            int n = epoll_wait(epoll_fd_, events, 64, -1);
+            if (n < 0 && errno != EINTR) {
+                perror("[ED] epoll_wait");
+                break;
+            }
+            for (int i = 0; i < n; ++i) {
+                if (events[i].data.u64 == WAKE_ID) {
+                    uint64_t count;
+                    ssize_t r = read(wake_fd_, &count, sizeof(count));
+                    (void)r;
+                    take_submissions();
+                    continue;
+                }
+                Conn& conn = conns_[events[i].data.u64];
+                if (conn.fd < 0) continue;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    fail(conn);
+                    continue;
+                }
+                if ((events[i].events & EPOLLOUT) && !on_writable(conn)) continue;
+                if (events[i].events & EPOLLIN) on_readable(conn);
+            }
+            if (stopping_ && active_ == 0) {
+                std::lock_guard<std::mutex> lock(submit_mutex_);
+                if (submitted_.empty()) break;
+            }
+        }
+    }
+
+    void take_submissions() {
+        std::vector<Task> batch;
+        std::vector<int> cancels;
+        {
+            std::lock_guard<std::mutex> lock(submit_mutex_);
+            batch.swap(submitted_);
+            cancels.swap(cancels_);
+        }
+        for (const Task& task : batch) dispatch(task);
+        for (int token : cancels) cancel_inflight(token);
+    }
+
+    // Sends a CANCEL if the EC still has the task; either way its EC side is
+    // accounted for afterwards.
+    void cancel_inflight(int token) {
+        hedge_settled(token);
+        for (Conn& conn : conns_) {
+            auto it = conn.inflight.find(token);
+            if (it == conn.inflight.end()) continue;
+            oms::MsgHeader cancel;
+            cancel.type = oms::MSG_CANCEL;
+            cancel.model = model_id;
+            cancel.device = device_id;
+            cancel.token = token;
+            cancel.arg = it->second.token_ec;
+            conn.inflight.erase(it);
+            active_--;
+            queue_frame(conn, cancel, 0);
             return;
         }
-        long now_ms = current_time_ms();
+    }
+
+    // Hedge when neither side is clearly faster: |ec - local| within the
+    // margin of the faster prediction.
+    bool should_hedge(const Task& task) {
+        if (hedge_margin <= 0) return false;
+        double ec = links_[model_id].ec_latency_ms;
+        double local = predict_local_ms();
+        if (ec < 0 || local < 0) return false;
+        if (local > 0 && std::abs(ec - local) > hedge_margin * std::min(ec, local)) return false;
         {
-            std::lock_guard<std::mutex> lock(time_map_mutex);
-            task_end_time[token_ed] = now_ms;  // Mark task death time
+            std::lock_guard<std::mutex> lock(hedge_mutex);
+            hedged_tasks[task.token] = HedgeState::RACING;
         }
-        auto end = std::chrono::high_resolution_clock::now();
-        long duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
         {
             std::lock_guard<std::mutex> lock(stats_mutex);
-            completed_tasks++;
-            total_latency_ms += duration;
-            sent_to_ec++;
+            hedged_started++;
         }
-        log_result("[ED_SENT] token_ed=" + std::to_string(token_ed) + " token_ec=" + token_ec + " duration=" + std::to_string(duration) + " ms");
-    } else if (response == "DROP") {
-        enqueue_local_run(token_ed, get_random_image_from_coco());
-        {
+        enqueue_local_run(task.token, task.image, task.deadline);
+        return true;
+    }
+
+    // The offload side of a task failed or was dropped. A hedged task's local
+    // copy carries on as an ordinary local run, anything else falls back now.
+    void offload_failed(const Task& task) {
+        if (!task.hedged) run_locally(task.token, task.image, task.deadline);
+        else hedge_side_failed(task.token, false);
+    }
+
+    // Eager wins when the admission RTT it saves, weighted by the chance of
+    // being admitted, beats the upload it wastes when the EC drops the task.
+    // Every 16th task stays lazy in auto mode so the RTT estimate stays fresh.
+    bool choose_eager(uint8_t model, uint32_t payload) {
+        if (eager_mode != EagerMode::AUTO) return eager_mode == EagerMode::ON;
+        LinkStats& link = links_[model];
+        if (link.rtt_ms < 0 || ++link.lazy_count % 16 == 0) return false;
+        double upload_ms = payload * 8.0 / (link_mbps * 1000.0);
+        return link.accept * link.rtt_ms > (1.0 - link.accept) * upload_ms;
+    }
+
+    void observe(uint8_t model, bool admitted, const Task* lazy_task) {
+        LinkStats& link = links_[model];
+        link.accept = 0.9 * link.accept + 0.1 * (admitted ? 1.0 : 0.0);
+        if (!lazy_task) return;
+        double rtt = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - lazy_task->sent).count();
+        link.rtt_ms = link.rtt_ms < 0 ? rtt : 0.875 * link.rtt_ms + 0.125 * rtt;
+    }
+
+    static uint32_t budget_ms(const Task& task) {
+        if (task.deadline == NO_DEADLINE) return 0;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            task.deadline - std::chrono::steady_clock::now()).count();
+        return static_cast<uint32_t>(std::max<long>(1, left));
+    }
+
+    Conn* conn_with_credit() {
+        for (size_t k = 0; k < EC_CONNS; ++k) {
+            Conn& conn = conns_[(next_conn_ + k) % EC_CONNS];
+            if (conn.fd >= 0 && conn.credits > 0) return &conn;
+        }
+        return nullptr;
+    }
+
+    void dispatch(Task task) {
+        size_t idx = next_conn_++ % EC_CONNS;
+        Conn* conn = &conns_[idx];
+        if (conn->fd < 0 && !open_conn(*conn, idx)) {
+            run_locally(task.token, task.image, task.deadline);
+            return;
+        }
+        const ImageCatalog::Entry& img = catalog.entry(task.image);
+        oms::MsgHeader req;
+        req.type = oms::MSG_REQ;
+        req.model = model_id;
+        req.device = device_id;
+        req.token = task.token;
+        req.arg = img.size;
+        req.budget_ms = budget_ms(task);
+        bool credited = false;
+        if (use_credits) {
+            if (Conn* with_credit = conn_with_credit()) {
+                conn = with_credit;
+                conn->credits--;
+                credited = true;
+            } else if (conn->credit_known && ++uncredited_ % CREDIT_PROBE_EVERY != 0) {
+                {
+                    std::lock_guard<std::mutex> lock(stats_mutex);
+                    credit_local++;
+                }
+                run_locally(task.token, task.image, task.deadline);
+                return;
+            }
+        }
+        LinkStats& link = links_[model_id];
+        if (!credited && std::chrono::steady_clock::now() < link.suppress_until &&
+            ++link.suppressed % SUPPRESS_PROBE_EVERY != 0) {
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                suppressed_local++;
+            }
+            run_locally(task.token, task.image, task.deadline);
+            return;
+        }
+        task.hedged = should_hedge(task);
+        task.eager = credited || choose_eager(model_id, img.size);
+        task.sent = std::chrono::steady_clock::now();
+        if (task.eager) {
+            req.flags |= oms::FLAG_EAGER | (credited ? oms::FLAG_CREDIT : 0);
+            req.payload_len = img.size;
             std::lock_guard<std::mutex> lock(stats_mutex);
-            completed_tasks++;
-            ran_on_ed++;
+            eager_sent++;
+            if (credited) credit_spent++;
+        }
+        conn->inflight[task.token] = task;
+        active_++;
+        queue_frame(*conn, req, img.offset);
+    }
+
+    bool open_conn(Conn& conn, size_t idx) {
+        int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (sock < 0) {
+            perror("[ED] socket failed");
+            return false;
+        }
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+        sockaddr_in serv_addr{};
+        serv_addr.sin_family = AF_INET;
+        serv_addr.sin_port = htons(PORT);
+        inet_pton(AF_INET, EC_IP, &serv_addr.sin_addr);
+        if (connect(sock, (sockaddr*)&serv_addr, sizeof(serv_addr)) < 0 && errno != EINPROGRESS) {
+            perror("[ED] connect failed");
+            close(sock);
+            return false;
+        }
+        conn.fd = sock;
+        conn.connecting = true;
+        conn.in.clear();
+        conn.events = EPOLLIN | EPOLLOUT;
+        epoll_event ev{};
+        ev.events = conn.events;
+        ev.data.u64 = idx;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, sock, &ev);
+        if (use_credits) {
+            oms::MsgHeader subscribe;
+            subscribe.type = oms::MSG_CREDIT;
+            subscribe.model = model_id;
+            subscribe.device = device_id;
+            subscribe.budget_ms = slo_ms[model_id];  // lets the EC size credits to our SLO
+            queue_frame(conn, subscribe, 0);
         }
-        log_result("[ED_FALLBACK] token_ed=" + std::to_string(token_ed) + " fallback");
+        return true;
     }
-    close(sock);
+
+    // Closes the connection and sends everything still in flight on it to
+    // the local fallback.
+    void fail(Conn& conn) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+        close(conn.fd);
+        conn.fd = -1;
+        conn.connecting = false;
+        conn.out.clear();
+        conn.in.clear();
+        conn.credits = 0;
+        conn.credit_known = false;
+        for (auto& kv : conn.inflight) {
+            offload_failed(kv.second);
+            active_--;
+        }
+        conn.inflight.clear();
+    }
+
+    void queue_frame(Conn& conn, const oms::MsgHeader& hdr, off_t file_off) {
+        conn.out.emplace_back();
+        OutFrame& frame = conn.out.back();
+        oms::encode_header(hdr, frame.head);
+        frame.file_off = file_off;
+        frame.file_len = hdr.payload_len;
+        if (!conn.connecting) flush(conn);
+    }
+
+    void set_events(Conn& conn, uint32_t events) {
+        if (conn.events == events) return;
+        conn.events = events;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = &conn - conns_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &ev);
+    }
+
+    bool on_writable(Conn& conn) {
+        if (conn.connecting) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err != 0) {
+                errno = err;
+                perror("[ED] connect failed");
+                fail(conn);
+                return false;
+            }
+            conn.connecting = false;
+        }
+        return flush(conn);
+    }
+
+    // Writes queued frames until the socket would block. Frames other than
+    // the last go out with MSG_MORE so small headers share segments.
+    bool flush(Conn& conn) {
+        while (!conn.out.empty()) {
+            OutFrame& frame = conn.out.front();
+            bool more = frame.file_len > 0 || conn.out.size() > 1;
+            while (frame.head_sent < oms::HEADER_SIZE) {
+                ssize_t n = send(conn.fd, frame.head + frame.head_sent, oms::HEADER_SIZE - frame.head_sent,
+                                 MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+                if (n < 0 && errno == EAGAIN) {
+                    set_events(conn, EPOLLIN | EPOLLOUT);
+                    return true;
+                }
+                if (n <= 0) {
+                    fail(conn);
+                    return false;
+                }
+                frame.head_sent += n;
+            }
+            while (frame.file_sent < frame.file_len) {
+                off_t offset = frame.file_off + frame.file_sent;
+                ssize_t n = sendfile(conn.fd, catalog.fd(), &offset, frame.file_len - frame.file_sent);
+                if (n < 0 && errno == EAGAIN) {
+                    set_events(conn, EPOLLIN | EPOLLOUT);
+                    return true;
+                }
+                if (n <= 0) {
+                    fail(conn);
+                    return false;
+                }
+                frame.file_sent += n;
+            }
+            conn.out.pop_front();
+        }
+        set_events(conn, EPOLLIN);
+        return true;
+    }
+
+    void on_readable(Conn& conn) {
+        char buf[16384];
+        while (true) {
+            ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EAGAIN) break;
+            if (n <= 0) {
+                fail(conn);
+                return;
+            }
+            conn.in.insert(conn.in.end(), buf, buf + n);
+        }
+        size_t pos = 0;
+        oms::MsgHeader hdr;
+        while (conn.in.size() - pos >= oms::HEADER_SIZE) {
+            if (!oms::decode_header(conn.in.data() + pos, hdr) || hdr.payload_len > oms::MAX_PAYLOAD) {
+                std::cerr << "[ED] Bad frame from EC\n";
+                fail(conn);
+                return;
+            }
+            if (conn.in.size() - pos < oms::HEADER_SIZE + hdr.payload_len) break;
+            pos += oms::HEADER_SIZE + hdr.payload_len;
+            on_reply(conn, hdr, conn.in.data() + pos - hdr.payload_len);
+            if (conn.fd < 0) return;
+        }
+        conn.in.erase(conn.in.begin(), conn.in.begin() + pos);
+    }
+
+    // payload points at hdr.payload_len bytes inside conn.in, valid for the call
+    void on_reply(Conn& conn, const oms::MsgHeader& hdr, const char* payload) {
+        if (hdr.type == oms::MSG_CREDIT) {
+            conn.credits += hdr.arg;
+            conn.credit_known = true;
+            return;
+        }
+        auto it = conn.inflight.find(hdr.token);
+        if (it == conn.inflight.end()) return;
+        Task& task = it->second;
+        if (hdr.type == oms::MSG_GRANT) {
+            observe(model_id, true, &task);
+            task.token_ec = hdr.arg;
+            const ImageCatalog::Entry& img = catalog.entry(task.image);
+            oms::MsgHeader data;
+            data.type = oms::MSG_DATA;
+            data.model = model_id;
+            data.device = device_id;
+            data.token = task.token;
+            data.arg = task.token_ec;
+            data.budget_ms = budget_ms(task);
+            data.payload_len = img.size;
+            queue_frame(conn, data, img.offset);
+            return;
+        }
+        if (hdr.type == oms::MSG_DONE) {
+            if (task.eager) observe(model_id, true, nullptr);
+            long duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - task.start).count();
+            LinkStats& link = links_[model_id];
+            link.ec_latency_ms = link.ec_latency_ms < 0 ? duration : 0.9 * link.ec_latency_ms + 0.1 * duration;
+            Claim claim = claim_task(task.token, false);
+            if (claim == Claim::LOST) {
+                log_result("[ED_HEDGE_LOST] token_ed=" + std::to_string(task.token) + " ec");
+            } else {
+                if (claim == Claim::WON) {
+                    if (cancel_local_run(task.token)) hedge_settled(task.token);
+                    std::lock_guard<std::mutex> lock(stats_mutex);
+                    hedge_ec_won++;
+                }
+                record_offload(task.token, hdr.arg, duration, oms::ResultView(payload, hdr.payload_len));
+            }
+        } else if (hdr.type == oms::MSG_DROP) {
+            // A late DROP came after the upload and is no admission decision
+            if (!(hdr.flags & oms::FLAG_LATE)) observe(model_id, false, task.eager ? nullptr : &task);
+            auto retry_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(hdr.arg);
+            LinkStats& link = links_[model_id];
+            link.suppress_until = std::max(link.suppress_until, retry_at);
+            if (task.eager) {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                eager_dropped++;
+                eager_wasted_bytes += catalog.entry(task.image).size;
+            }
+            offload_failed(task);
+        } else {
+            return;
+        }
+        conn.inflight.erase(it);
+        active_--;
+    }
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+    std::mutex submit_mutex_;
+    bool stopped_ = false;  // finish() closed the fds, guarded by submit_mutex_
+    std::vector<Task> submitted_;
+    std::vector<int> cancels_;
+    Conn conns_[EC_CONNS];
+    size_t next_conn_ = 0;
+    unsigned uncredited_ = 0;
+    LinkStats links_[oms::MODEL_COUNT];
+    int active_ = 0;  // tasks in flight on any connection, engine thread only
+};
+
+OffloadEngine engine;
+
+void cancel_offload(int token_ed) {
+    engine.cancel(token_ed);
+}
+
+// "--slo=resnet_50:300,yolov5s:700"; a bare number applies to the run's model
+bool parse_slo(const std::string& spec) {
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos) end = spec.size();
+        std::string item = spec.substr(pos, end - pos);
+        size_t colon = item.find(':');
+        oms::ModelId model = model_id;
+        if (colon != std::string::npos && !oms::model_from_name(item.substr(0, colon), model)) return false;
+        try {
+            slo_ms[model] = std::stoul(colon == std::string::npos ? item : item.substr(colon + 1));
+        } catch (const std::exception&) {
+            return false;
+        }
+        pos = end + 1;
+    }
+    return true;
 }
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        std::cerr << "Usage: ./ed_oms <lambda_rate> <duration_sec>\n";
+        std::cerr << "Usage: ./ed_oms <lambda_rate> <duration_sec> [model] [--option=value ...]\n"
+                  << "  --dist=uniform|zipf|seq   image sampling (default uniform)\n"
+                  << "  --zipf=<s>                Zipf exponent (default 1.0)\n"
+                  << "  --seed=<n>                workload seed (default random)\n"
+                  << "  --image-dir=<dir>         images to preload (default " << IMAGE_DIR << ")\n"
+                  << "  --eager=auto|on|off       send the image with the REQ (default auto)\n"
+                  << "  --link-mbps=<n>           uplink bandwidth for --eager=auto (default 100)\n"
+                  << "  --credits=on|off          use EC admission credits (default on)\n"
+                  << "  --device=PI5|PI3|QIDK     device tag sent to the EC (default PI5)\n"
+                  << "  --slo=<model>:<ms>[,...]  per-model deadline, e.g. resnet_50:300,yolov5s:700\n"
+                  << "  --hedge=<margin>          run on both sides when predictions are within\n"
+                  << "                            this fraction of each other (default 0, off)\n"
+                  << "  --local=native|python|shm run fallbacks in process with OpenCV DNN, or in the\n"
+                  << "                            python helper over a pipe and FIFO or shared memory\n"
+                  << "                            (default native if built with OpenCV, else python)\n"
+                  << "  --model-dir=<dir>         ONNX exports for --local=native (default .)\n"
+                  << "  --local-workers=<n>|auto  persistent native or shm workers, each pinned to\n"
+                  << "                            its own cores (default auto: cores / local threads)\n"
+                  << "  --local-threads=<n>       intra-op threads of each local worker (default 1)\n";
         return 1;
     }
     double lambda_rate = std::stod(argv[1]);
     int duration_sec = std::stoi(argv[2]);
 
+    ImageDist image_dist = ImageDist::UNIFORM;
+    double zipf_s = 1.0;
+    uint64_t seed = std::random_device{}();
+    std::string image_dir = IMAGE_DIR;
+    std::string slo_spec;
+#ifdef ED_HAVE_OPENCV
+    LocalMode local_mode = LocalMode::NATIVE;
+#else
+    LocalMode local_mode = LocalMode::PYTHON;
+#endif
+    std::string model_dir = ".";
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string key = arg.substr(0, arg.find('='));
+        std::string value = arg.find('=') == std::string::npos ? "" : arg.substr(arg.find('=') + 1);
+        bool ok = true;
+        if (arg.rfind("--", 0) != 0) ok = oms::model_from_name(arg, model_id);
+        else if (key == "--dist") ok = parse_image_dist(value, image_dist);
+        else if (key == "--zipf") zipf_s = std::stod(value);
+        else if (key == "--seed") seed = std::stoull(value);
+        else if (key == "--image-dir") image_dir = value;
+        else if (key == "--eager") {
+            if (value == "auto") eager_mode = EagerMode::AUTO;
+            else if (value == "on") eager_mode = EagerMode::ON;
+            else if (value == "off") eager_mode = EagerMode::OFF;
+            else ok = false;
+        }
+        else if (key == "--link-mbps") link_mbps = std::stod(value);
+        else if (key == "--slo") slo_spec = value;
+        else if (key == "--device") ok = oms::device_from_name(value, device_id);
+        else if (key == "--hedge") hedge_margin = std::stod(value);
+        else if (key == "--credits") {
+            ok = value == "on" || value == "off";
+            use_credits = value == "on";
+        }
+        else if (key == "--local") {
+            if (value == "native") local_mode = LocalMode::NATIVE;
+            else if (value == "python") local_mode = LocalMode::PYTHON;
+            else if (value == "shm") local_mode = LocalMode::SHM;
+            else ok = false;
+        }
+        else if (key == "--model-dir") model_dir = value;
+        else if (key == "--local-workers") local_workers = value == "auto" ? 0 : std::max(1, std::stoi(value));
+        else if (key == "--local-threads") local_threads = std::max(1, std::stoi(value));
+        else ok = false;
+        if (!ok) {
+            std::cerr << "[ED] Bad argument " << arg << "\n";
+            return 1;
+        }
+    }
+
+    // After the loop, so that a bare number applies to the model given anywhere
+    if (!slo_spec.empty() && !parse_slo(slo_spec)) {
+        std::cerr << "[ED] Bad argument --slo=" << slo_spec << "\n";
+        return 1;
+    }
+
+    if (!catalog.load(image_dir, IMAGE)) {
+        std::cerr << "[ED] No images found in " << image_dir << " or " << IMAGE << "\n";
+        return 1;
+    }
+    catalog.set_distribution(image_dist, seed, zipf_s);
+    std::cout << "[ED] Loaded " << catalog.size() << " images (" << catalog.bytes() / 1024
+              << " KB), seed=" << seed << "\n";
+
     std::atomic<int> total_generated{0};
-    std::queue<int> task_queue;
-    std::mutex task_queue_mutex;
-    std::condition_variable task_queue_cv;
-    std::atomic<bool> all_generated{false};
 
-    FILE* py = start_python_helper(duration_sec);
-    std::thread py_thread(local_run_dispatch, py);
-    std::thread listener_thread(start_done_listener);
+    // Pool size: as many workers as there are cores for their intra-op threads
+    if (local_mode == LocalMode::PYTHON) local_workers = 1;
+    else if (local_workers == 0)
+        local_workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / local_threads);
+    local_tasks.resize(local_workers);
+
+    if (local_mode != LocalMode::NATIVE) {
+        const char* script = helper_script(model_id);
+        if (!script || access(script, R_OK) != 0) {
+            std::cerr << "[ED] No python fallback helper for " << oms::model_name(model_id)
+                      << (script ? std::string(" (") + script + " not found)" : std::string()) << "\n";
+            return 1;
+        }
+    }
+
+    FILE* py = nullptr;
+    std::vector<std::thread> workers;
+    std::thread listener_thread;
+#ifdef ED_HAVE_OPENCV
+    std::vector<LocalFallback> fallbacks(local_mode == LocalMode::NATIVE ? local_workers : 0);
+    if (local_mode == LocalMode::NATIVE) {
+        cv::setNumThreads(local_threads);
+        for (auto& fallback : fallbacks) {
+            if (!fallback.load(model_id, model_dir)) {
+                std::cerr << "[ED] Cannot load an ONNX export of " << oms::model_name(model_id) << " from " << model_dir
+                          << " (use --local=python)\n";
+                return 1;
+            }
+        }
+        std::cout << "[ED] Local fallback in process on " << fallbacks[0].file() << ", " << local_workers
+                  << " worker(s) x " << local_threads << " thread(s)\n";
+        for (int w = 0; w < local_workers; ++w) workers.emplace_back(native_worker, w, &fallbacks[w]);
+    }
+#else
+    if (local_mode == LocalMode::NATIVE) {
+        std::cerr << "[ED] Built without -DED_HAVE_OPENCV, --local=native is unavailable\n";
+        return 1;
+    }
+#endif
+    if (local_mode == LocalMode::SHM) {
+        uint32_t largest = 0;
+        for (size_t i = 0; i < catalog.size(); ++i) largest = std::max(largest, catalog.entry(i).size);
+        std::cout << "[ED] Local fallback in " << local_workers << " helper(s) over shared memory x "
+                  << local_threads << " thread(s)\n";
+        shm_helpers = local_workers;
+        for (int w = 0; w < local_workers; ++w) workers.emplace_back(shm_worker, w, duration_sec, largest);
+    } else if (local_mode == LocalMode::PYTHON) {
+        py = start_python_helper(duration_sec);
+        workers.emplace_back(local_run_dispatch, py);
+        listener_thread = std::thread(start_done_listener);
+    }
+
+    if (!engine.start()) {
+        perror("[ED] offload engine");
+        return 1;
+    }
 
-    std::mt19937 gen(std::random_device{}());
+    std::mt19937 gen(seed);
     std::exponential_distribution<double> dist(lambda_rate);
 
     std::thread generator([&]() {
@@ -235,52 +1208,25 @@ int main(int argc, char* argv[]) {
             if (std::chrono::duration_cast<std::chrono::seconds>(now - start).count() >= duration_sec) break;
 
             {
-                std::lock_guard<std::mutex> lock(task_queue_mutex);
-                task_queue.push(token);
-                {
-                    std::lock_guard<std::mutex> lock2(time_map_mutex);
-                    task_start_time[token] = current_time_ms();  // Mark task birth
-                }
-                token++;
+                std::lock_guard<std::mutex> lock(time_map_mutex);
+                task_start_time[token] = current_time_ms();  // Mark task birth
             }
+            engine.submit(token, catalog.sample());
+            token++;
             total_generated++;
-            task_queue_cv.notify_one();
             std::this_thread::sleep_for(std::chrono::duration<double>(dist(gen)));
         }
-        all_generated = true;
-        task_queue_cv.notify_all();
     });
 
-    const int POOL_SIZE = 32;
-    std::vector<std::thread> workers;
-    for (int i = 0; i < POOL_SIZE; ++i) {
-        workers.emplace_back([&]() {
-            while (true) {
-                int token = -1;
-                {
-                    std::unique_lock<std::mutex> lock(task_queue_mutex);
-                    task_queue_cv.wait(lock, [&]() { return !task_queue.empty() || all_generated; });
-                    if (task_queue.empty() && all_generated) return;
-                    token = task_queue.front();
-                    task_queue.pop();
-                }
-                run_request(token);
-            }
-        });
-    }
-
     generator.join();
-    for (auto& w : workers) w.join();
+    engine.finish();
 
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex);
-        stop_local = true;
+    local_tasks.close();
+    for (auto& worker : workers) worker.join();
+    if (py) {
+        pclose(py);
+        listener_thread.join();
     }
-    queue_cv.notify_one();
-
-    py_thread.join();
-    pclose(py);
-    listener_thread.join();
 
     double total_local_infer_time = 0;
     int local_infer_count = 0;
@@ -295,17 +1241,26 @@ int main(int argc, char* argv[]) {
 
     long total_e2e_time = 0;
     int e2e_count = 0;
+    int within_slo = 0;
+    std::vector<long> e2e_samples;
     {
         std::lock_guard<std::mutex> lock(time_map_mutex);
         for (const auto& kv : task_start_time) {
             int token = kv.first;
             if (task_end_time.count(token)) {
-                total_e2e_time += (task_end_time[token] - task_start_time[token]);
+                long e2e = task_end_time[token] - task_start_time[token];
+                e2e_samples.push_back(e2e);
+                total_e2e_time += e2e;
                 e2e_count++;
+                if (!slo_ms[model_id] || e2e <= slo_ms[model_id]) within_slo++;
             }
         }
     }
     long avg_e2e_latency = e2e_count ? (total_e2e_time / e2e_count) : 0;
+    double goodput = duration_sec ? static_cast<double>(within_slo) / duration_sec : 0;
+    std::sort(e2e_samples.begin(), e2e_samples.end());
+    long p50_e2e = e2e_samples.empty() ? 0 : e2e_samples[e2e_samples.size() / 2];
+    long p99_e2e = e2e_samples.empty() ? 0 : e2e_samples[e2e_samples.size() * 99 / 100];
 
     std::cout << "\n===== FINAL STATS =====\n";
     std::cout << "Total tasks completed:   " << completed_tasks << "\n";
@@ -313,6 +1268,23 @@ int main(int argc, char* argv[]) {
     std::cout << "Tasks run locally (DROP):" << ran_on_ed << "\n";
     std::cout << "Avg pure model inference time (DROP): " << avg_local_infer_time << " ms\n";
     std::cout << "Avg total E2E latency (EC + ED):       " << avg_e2e_latency << " ms\n";
+    std::cout << "Eager offloads (DROPped):              " << eager_sent << " (" << eager_dropped
+              << ", " << eager_wasted_bytes / 1024 << " KB wasted)\n";
+    std::cout << "Credits spent / local without asking:  " << credit_spent << " / " << credit_local << "\n";
+    std::cout << "Local during DROP retry-after window:  " << suppressed_local << "\n";
+    std::cout << "SLO (" << oms::model_name(model_id) << "):                     ";
+    if (slo_ms[model_id]) std::cout << slo_ms[model_id] << " ms\n";
+    else std::cout << "none\n";
+    std::cout << "Tasks completed within SLO:            " << within_slo << "\n";
+    std::cout << "Local tasks skipped (deadline passed): " << expired_local << "\n";
+    std::cout << "Local runs failed:                     " << failed_local << "\n";
+    std::cout << "Local workers x threads:               " << local_workers << " x " << local_threads << "\n";
+    std::cout << "Goodput:                               " << goodput << " tasks/s\n";
+    std::cout << "P50 / P99 E2E latency:                 " << p50_e2e << " / " << p99_e2e << " ms\n";
+    std::cout << "Hedged tasks (local won / EC won):     " << hedged_started << " (" << hedge_local_won
+              << " / " << hedge_ec_won << ")\n";
+    std::cout << "Avg EC result size (malformed):        " << (sent_to_ec ? ec_result_bytes / sent_to_ec : 0)
+              << " B (" << ec_bad_results << ")\n";
     std::cout << "=========================" << std::endl;
 
     return 0;
@@ -0,0 +1,30 @@
+"""Notify FIFO of the ED's --local=python fallback helpers.
+
+The ED writes "token:path" lines to a helper's stdin, one task at a time,
+and waits for the task's line on the FIFO before sending the next, so every
+task is reported, failures included: "token,infer_ms,done_ms,status" with
+status 0 = ok. A line the helper cannot parse is reported as token -1.
+"""
+import os
+import sys
+import time
+
+
+class DoneFifo:
+    def __init__(self, path):
+        if not os.path.exists(path):
+            os.mkfifo(path)
+        self.out = open(path, "w")
+        print("[INFO] FIFO opened successfully.")
+
+    def report(self, token, infer_ms, ok=True):
+        try:
+            done_ms = int(time.time() * 1000)
+            self.out.write(f"{token},{infer_ms:.2f},{done_ms},{0 if ok else 1}\n")
+            self.out.flush()
+            print(f"[INFO] Written result to FIFO: {token}, {infer_ms:.2f} ms")
+        except Exception as e:
+            print(f"[ERROR] Failed to write to FIFO: {e}", file=sys.stderr)
+
+    def close(self):
+        self.out.close()
@@ -0,0 +1,141 @@
+// Image workload loaded once at startup.
+//
+// All JPEGs of a directory are packed back to back into one memfd-backed
+// arena, which is mmap'd for readers and can be handed to sendfile() with an
+// offset. Sampling is O(1) for every distribution and reproducible with a
+// seed.
+#pragma once
+#include <string>
+#include <vector>
+#include <random>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+enum class ImageDist { UNIFORM, ZIPF, SEQUENTIAL };
+
+inline bool parse_image_dist(const std::string& name, ImageDist& dist) {
+    if (name == "uniform") dist = ImageDist::UNIFORM;
+    else if (name == "zipf") dist = ImageDist::ZIPF;
+    else if (name == "seq" || name == "sequential") dist = ImageDist::SEQUENTIAL;
+    else return false;
+    return true;
+}
+
+class ImageCatalog {
+public:
+    struct Entry {
+        std::string path;
+        uint64_t offset;  // into the arena
+        uint32_t size;
+    };
+
+    ~ImageCatalog() {
+        if (base_) munmap(base_, arena_size_);
+        if (fd_ >= 0) close(fd_);
+    }
+
+    // Loads every regular file of dir (sorted by name, so indices are stable
+    // across runs), or only fallback if the directory is missing or empty.
+    bool load(const std::string& dir, const std::string& fallback) {
+        std::vector<std::string> paths;
+        if (DIR* d = opendir(dir.c_str())) {
+            while (dirent* e = readdir(d))
+                if (e->d_type == DT_REG) paths.push_back(dir + "/" + e->d_name);
+            closedir(d);
+        }
+        std::sort(paths.begin(), paths.end());
+        if (paths.empty()) paths.push_back(fallback);
+
+        fd_ = memfd_create("image_catalog", 0);
+        if (fd_ < 0) return false;
+        std::vector<char> buf;
+        for (const auto& path : paths) {
+            int in = open(path.c_str(), O_RDONLY);
+            if (in < 0) continue;
+            struct stat st;
+            if (fstat(in, &st) == 0 && st.st_size > 0) {
+                buf.resize(st.st_size);
+                if (pread(in, buf.data(), buf.size(), 0) == st.st_size &&
+                    pwrite(fd_, buf.data(), buf.size(), arena_size_) == st.st_size) {
+                    entries_.push_back({path, arena_size_, static_cast<uint32_t>(st.st_size)});
+                    arena_size_ += st.st_size;
+                }
+            }
+            close(in);
+        }
+        if (entries_.empty()) return false;
+        void* base = mmap(nullptr, arena_size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (base == MAP_FAILED) return false;
+        base_ = static_cast<char*>(base);
+        return true;
+    }
+
+    void set_distribution(ImageDist dist, uint64_t seed, double zipf_s = 1.0) {
+        std::lock_guard<std::mutex> lock(rng_mutex_);
+        dist_ = dist;
+        rng_.seed(seed);
+        if (dist == ImageDist::ZIPF) build_alias_table(zipf_s);
+    }
+
+    size_t sample() {
+        size_t n = entries_.size();
+        if (dist_ == ImageDist::SEQUENTIAL) return next_++ % n;
+        std::lock_guard<std::mutex> lock(rng_mutex_);
+        size_t i = std::uniform_int_distribution<size_t>(0, n - 1)(rng_);
+        if (dist_ == ImageDist::UNIFORM) return i;
+        // Walker/Vose alias method: one bucket pick plus one coin flip
+        return std::uniform_real_distribution<double>(0, 1)(rng_) < prob_[i] ? i : alias_[i];
+    }
+
+    const Entry& entry(size_t i) const { return entries_[i]; }
+    const char* data(size_t i) const { return base_ + entries_[i].offset; }
+    size_t size() const { return entries_.size(); }
+    uint64_t bytes() const { return arena_size_; }
+    int fd() const { return fd_; }
+
+private:
+    void build_alias_table(double s) {
+        size_t n = entries_.size();
+        std::vector<double> p(n);
+        double norm = 0;
+        for (size_t i = 0; i < n; ++i) norm += p[i] = 1.0 / std::pow(i + 1, s);
+        prob_.assign(n, 1.0);
+        alias_.assign(n, 0);
+        std::vector<size_t> small, large;
+        for (size_t i = 0; i < n; ++i) {
+            p[i] = p[i] * n / norm;
+            (p[i] < 1.0 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            size_t l = small.back(), g = large.back();
+            small.pop_back();
+            prob_[l] = p[l];
+            alias_[l] = g;
+            p[g] -= 1.0 - p[l];
+            if (p[g] < 1.0) {
+                large.pop_back();
+                small.push_back(g);
+            }
+        }
+    }
+
+    std::vector<Entry> entries_;
+    int fd_ = -1;
+    char* base_ = nullptr;
+    uint64_t arena_size_ = 0;
+
+    ImageDist dist_ = ImageDist::UNIFORM;
+    std::mutex rng_mutex_;
+    std::mt19937_64 rng_;
+    std::atomic<size_t> next_{0};
+    std::vector<double> prob_;
+    std::vector<size_t> alias_;
+};
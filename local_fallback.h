@@ -0,0 +1,75 @@
+// In-process local inference for the ED's fallback path.
+//
+// Loads the same ONNX exports as the python helpers and runs them through
+// OpenCV DNN on images straight from the catalog's arena, so a local task
+// costs no interpreter, no pipe and FIFO round trip and no text parsing.
+// Only compiled when the build defines ED_HAVE_OPENCV and links OpenCV (see
+// README.md); otherwise the ED keeps the python helper.
+#pragma once
+#ifdef ED_HAVE_OPENCV
+#include <string>
+#include <opencv2/opencv.hpp>
+#include "dnn_preprocess.h"
+#include "oms_protocol.h"
+
+class LocalFallback {
+public:
+    // Loads dir/resnet50.onnx or dir/yolov5s.onnx for model. False for the
+    // other models, which have no ONNX export, or if loading failed.
+    bool load(uint8_t model, const std::string& dir) {
+        switch (model) {
+        case oms::MODEL_RESNET50:
+            file_ = dir + "/resnet50.onnx";
+            input_ = cv::Size(224, 224);
+            imagenet_ = true;
+            break;
+        case oms::MODEL_YOLOV5S:
+            // Plain resize to the export's input instead of torch hub's letterbox
+            file_ = dir + "/yolov5s.onnx";
+            input_ = cv::Size(640, 640);
+            imagenet_ = false;
+            break;
+        default:
+            return false;
+        }
+        try {
+            net_ = cv::dnn::readNetFromONNX(file_);
+        } catch (const cv::Exception&) {
+            return false;
+        }
+        if (net_.empty()) return false;
+        net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+        net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+        return true;
+    }
+
+    const std::string& file() const { return file_; }
+
+    // Decodes one JPEG and runs the network on it. Like the helpers, the
+    // output is only computed, not interpreted. False if the image does not
+    // decode or OpenCV rejects it.
+    bool run(const char* jpeg, size_t len) {
+        try {
+            return infer(jpeg, len);
+        } catch (const cv::Exception&) {
+            return false;
+        }
+    }
+
+private:
+    bool infer(const char* jpeg, size_t len) {
+        cv::Mat encoded(1, static_cast<int>(len), CV_8UC1, const_cast<char*>(jpeg));
+        cv::Mat image = cv::imdecode(encoded, cv::IMREAD_COLOR);
+        if (image.empty()) return false;
+        net_.setInput(imagenet_ ? dnn_preprocess::imagenet_blob({image}, input_)
+                                : cv::dnn::blobFromImage(image, 1.0 / 255, input_, cv::Scalar(), true, false));
+        net_.forward();
+        return true;
+    }
+
+    cv::dnn::Net net_;
+    std::string file_;
+    cv::Size input_;
+    bool imagenet_ = false;  // ImageNet normalization, else only scaled to [0, 1]
+};
+#endif
@@ -0,0 +1,289 @@
+// Binary ED <-> EC offload protocol.
+//
+// Every message is a fixed 24-byte header followed by payload_len bytes of
+// payload. Multi-byte fields travel in network byte order. Replies echo the
+// ED token, so several requests can be in flight on one connection and be
+// answered out of order.
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <arpa/inet.h>
+
+namespace oms {
+
+const uint16_t MAGIC   = 0x4F4D;  // "OM"
+const uint8_t  VERSION = 3;
+
+enum MsgType : uint8_t {
+    MSG_REQ   = 1,  // ED -> EC: ask for admission, arg = image size in bytes
+    MSG_GRANT = 2,  // EC -> ED: admitted, arg = token_ec
+    MSG_DROP  = 3,  // EC -> ED: rejected, run locally; arg = retry-after ms
+    MSG_DATA  = 4,  // ED -> EC: image payload for a granted task
+    MSG_DONE  = 5,  // EC -> ED: inference finished, payload = result (see ResultKind)
+    MSG_CREDIT = 6, // ED -> EC: subscribe to credits (token 0, budget_ms = SLO)
+                    // EC -> ED: arg more admissions pre-approved on this connection
+    MSG_CANCEL = 7, // ED -> EC: the task finished elsewhere, skip it if not started
+};
+
+// MsgHeader.flags
+// FLAG_EAGER: the REQ already carries the image. If admitted the EC runs it
+// right away and answers DONE (arg = token_ec); otherwise it discards the
+// payload and answers DROP.
+const uint16_t FLAG_EAGER = 0x0001;
+// FLAG_CREDIT: the ED spends one of this connection's credits; sent together
+// with FLAG_EAGER, and the EC admits it without an admission check.
+const uint16_t FLAG_CREDIT = 0x0002;
+// FLAG_LATE: on a DROP, the EC had admitted the task and gave it up later
+// (pipeline full, image undecodable, queue shed), after the upload. It says
+// nothing about admission, so the ED leaves its admission estimates alone.
+const uint16_t FLAG_LATE = 0x0004;
+
+enum ModelId : uint8_t {
+    MODEL_RESNET50   = 0,
+    MODEL_YOLOV5S    = 1,
+    MODEL_RETINAFACE = 2,
+    MODEL_SSD        = 3,
+    MODEL_COUNT
+};
+
+enum DeviceId : uint8_t {
+    DEVICE_UNKNOWN = 0,
+    DEVICE_PI5     = 1,
+    DEVICE_PI3     = 2,
+    DEVICE_QIDK    = 3,
+    DEVICE_COUNT
+};
+
+struct MsgHeader {
+    uint8_t  type        = 0;
+    uint8_t  model       = MODEL_RESNET50;
+    uint8_t  device      = DEVICE_UNKNOWN;
+    uint16_t flags       = 0;
+    uint32_t token       = 0;  // token_ed, echoed in every reply
+    uint32_t arg         = 0;  // message specific, see MsgType
+    uint32_t budget_ms   = 0;  // time left until the task's deadline when sent, 0 = none
+    uint32_t payload_len = 0;
+};
+
+// Clocks of ED and EC are not synchronized, so deadlines travel as a
+// remaining budget and each side converts it to its own clock on receipt.
+const size_t HEADER_SIZE = 24;
+
+// Largest payload a peer accepts. A frame announcing more is treated as
+// garbage and its connection closed, before anything is allocated for it.
+const uint32_t MAX_PAYLOAD = 16 * 1024 * 1024;
+
+inline void encode_header(const MsgHeader& h, char* out) {
+    uint16_t magic  = htons(MAGIC);
+    uint16_t flags  = htons(h.flags);
+    uint32_t token  = htonl(h.token);
+    uint32_t arg    = htonl(h.arg);
+    uint32_t budget = htonl(h.budget_ms);
+    uint32_t len    = htonl(h.payload_len);
+    memcpy(out, &magic, 2);
+    out[2] = VERSION;
+    out[3] = h.type;
+    out[4] = h.model;
+    out[5] = h.device;
+    memcpy(out + 6, &flags, 2);
+    memcpy(out + 8, &token, 4);
+    memcpy(out + 12, &arg, 4);
+    memcpy(out + 16, &budget, 4);
+    memcpy(out + 20, &len, 4);
+}
+
+// Returns false on a bad magic or version; the connection should be dropped.
+inline bool decode_header(const char* in, MsgHeader& h) {
+    uint16_t magic, flags;
+    uint32_t token, arg, budget, len;
+    memcpy(&magic, in, 2);
+    if (ntohs(magic) != MAGIC || static_cast<uint8_t>(in[2]) != VERSION) return false;
+    h.type   = in[3];
+    h.model  = in[4];
+    h.device = in[5];
+    memcpy(&flags, in + 6, 2);
+    memcpy(&token, in + 8, 4);
+    memcpy(&arg, in + 12, 4);
+    memcpy(&budget, in + 16, 4);
+    memcpy(&len, in + 20, 4);
+    h.flags       = ntohs(flags);
+    h.token       = ntohl(token);
+    h.arg         = ntohl(arg);
+    h.budget_ms   = ntohl(budget);
+    h.payload_len = ntohl(len);
+    return true;
+}
+
+// MSG_DONE payload: a 4-byte result header (kind, reserved, record count)
+// followed by count fixed-size records of the kind's layout. Every field is
+// 4 bytes in network byte order; floats travel as their IEEE-754 bits.
+//   RESULT_CLASSES: class id, score                                     8 B
+//   RESULT_BOXES:   label, score, x, y, width, height                  24 B
+//   RESULT_FACES:   score, x, y, width, height, 5 landmark (x, y)      60 B
+// Coordinates are whatever the model reports (Vitis AI: relative to the
+// input image). RESULT_NONE carries no records.
+enum ResultKind : uint8_t {
+    RESULT_NONE    = 0,
+    RESULT_CLASSES = 1,
+    RESULT_BOXES   = 2,
+    RESULT_FACES   = 3,
+};
+
+const size_t RESULT_HEADER_SIZE = 4;
+const int FACE_LANDMARKS = 5;
+
+inline size_t result_record_size(uint8_t kind) {
+    switch (kind) {
+    case RESULT_CLASSES: return 2 * 4;
+    case RESULT_BOXES:   return 6 * 4;
+    case RESULT_FACES:   return (5 + 2 * FACE_LANDMARKS) * 4;
+    default:             return 0;
+    }
+}
+
+struct ClassScore { uint32_t id; float score; };
+struct Box { int32_t label; float score, x, y, width, height; };
+struct Face { float score, x, y, width, height; float landmarks[2 * FACE_LANDMARKS]; };
+
+// Appends a result to out, replacing what it held. The record count in the
+// header is kept current after every add.
+class ResultWriter {
+public:
+    ResultWriter(std::string& out, ResultKind kind) : out_(out) {
+        out_.assign(RESULT_HEADER_SIZE, 0);
+        out_[0] = static_cast<char>(kind);
+    }
+
+    void add(const ClassScore& c) {
+        put(c.id);
+        put(c.score);
+        counted();
+    }
+
+    void add(const Box& b) {
+        put(static_cast<uint32_t>(b.label));
+        for (float v : {b.score, b.x, b.y, b.width, b.height}) put(v);
+        counted();
+    }
+
+    void add(const Face& f) {
+        for (float v : {f.score, f.x, f.y, f.width, f.height}) put(v);
+        for (float v : f.landmarks) put(v);
+        counted();
+    }
+
+private:
+    void put(uint32_t v) {
+        v = htonl(v);
+        out_.append(reinterpret_cast<const char*>(&v), 4);
+    }
+    void put(float f) {
+        uint32_t v;
+        memcpy(&v, &f, 4);
+        put(v);
+    }
+    void counted() {
+        uint16_t count = htons(++count_);
+        memcpy(&out_[2], &count, 2);
+    }
+
+    std::string& out_;
+    uint16_t count_ = 0;
+};
+
+// Reads a result in place from the received payload; records are decoded
+// field by field on access, nothing is copied up front.
+class ResultView {
+public:
+    ResultView(const char* data, size_t len) : data_(data), len_(len) {}
+
+    // False if the payload is too short for the records it announces
+    bool valid() const {
+        return len_ >= RESULT_HEADER_SIZE && len_ >= RESULT_HEADER_SIZE + count() * result_record_size(kind());
+    }
+    uint8_t kind() const { return len_ ? static_cast<uint8_t>(data_[0]) : static_cast<uint8_t>(RESULT_NONE); }
+    size_t count() const {
+        if (len_ < RESULT_HEADER_SIZE) return 0;
+        uint16_t count;
+        memcpy(&count, data_ + 2, 2);
+        return ntohs(count);
+    }
+
+    ClassScore class_score(size_t i) const {
+        const char* p = record(i);
+        return ClassScore{u32(p), f32(p + 4)};
+    }
+
+    Box box(size_t i) const {
+        const char* p = record(i);
+        return Box{static_cast<int32_t>(u32(p)), f32(p + 4), f32(p + 8), f32(p + 12), f32(p + 16), f32(p + 20)};
+    }
+
+    Face face(size_t i) const {
+        const char* p = record(i);
+        Face f{f32(p), f32(p + 4), f32(p + 8), f32(p + 12), f32(p + 16), {}};
+        for (int j = 0; j < 2 * FACE_LANDMARKS; ++j) f.landmarks[j] = f32(p + 20 + 4 * j);
+        return f;
+    }
+
+private:
+    const char* record(size_t i) const { return data_ + RESULT_HEADER_SIZE + i * result_record_size(kind()); }
+    static uint32_t u32(const char* p) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return ntohl(v);
+    }
+    static float f32(const char* p) {
+        uint32_t v = u32(p);
+        float f;
+        memcpy(&f, &v, 4);
+        return f;
+    }
+
+    const char* data_;
+    size_t len_;
+};
+
+inline const char* model_name(uint8_t model) {
+    static const char* names[MODEL_COUNT] = {"resnet_50", "yolov5s", "retinaface", "ssd"};
+    return model < MODEL_COUNT ? names[model] : "unknown";
+}
+
+// Accepts the tags used by the run scripts ("resnet_50", "resnet50", "yolov5s", ...).
+inline bool model_from_name(const std::string& name, ModelId& model) {
+    for (uint8_t m = 0; m < MODEL_COUNT; ++m) {
+        if (name == model_name(m)) {
+            model = static_cast<ModelId>(m);
+            return true;
+        }
+    }
+    if (name == "resnet50" || name == "rn50") {
+        model = MODEL_RESNET50;
+        return true;
+    }
+    return false;
+}
+
+inline const char* device_name(uint8_t device) {
+    static const char* names[DEVICE_COUNT] = {"UNKNOWN", "PI5", "PI3", "QIDK"};
+    return device < DEVICE_COUNT ? names[device] : "UNKNOWN";
+}
+
+// Accepts the names above in any case ("PI5", "pi5", "qidk", ...).
+inline bool device_from_name(const std::string& name, DeviceId& device) {
+    for (uint8_t d = 0; d < DEVICE_COUNT; ++d) {
+        const char* known = device_name(d);
+        bool same = name.size() == strlen(known);
+        for (size_t i = 0; same && i < name.size(); ++i)
+            same = toupper(static_cast<unsigned char>(name[i])) == known[i];
+        if (same) {
+            device = static_cast<DeviceId>(d);
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace oms
@@ -24,6 +24,15 @@ end_model_time = time.perf_counter()
 model_load_time = (end_model_time - start_model_time) * 1000
 print(f"[INIT] Model loaded in {model_load_time:.2f} ms")
 
+# torchvision's ImageNet normalization, as dnn_preprocess.h applies it in C++
+MEAN = np.array([0.485, 0.456, 0.406], dtype=np.float32).reshape(1, 3, 1, 1)
+STD = np.array([0.229, 0.224, 0.225], dtype=np.float32).reshape(1, 3, 1, 1)
+
+
+def preprocess(image):
+    blob = cv2.dnn.blobFromImage(image, scalefactor=1.0/255, size=(224, 224), swapRB=True, crop=False)
+    return (blob - MEAN) / STD
+
 # ========== Batch Mode ==========
 if len(sys.argv) == 3 and os.path.isdir(sys.argv[1]):
     image_dir = sys.argv[1]
@@ -58,10 +67,7 @@ if len(sys.argv) == 3 and os.path.isdir(sys.argv[1]):
             print(f"[WARN] Skipped: {image_path}")
             continue
 
-        blob = cv2.dnn.blobFromImage(
-            image, scalefactor=1.0/255, size=(224, 224),
-            mean=(0.485, 0.456, 0.406), swapRB=True, crop=False
-        )
+        blob = preprocess(image)
         model.setInput(blob)
         _ = model.forward()[0]
         end = time.perf_counter()
@@ -80,8 +86,38 @@ if len(sys.argv) == 3 and os.path.isdir(sys.argv[1]):
     print("====================================")
     sys.exit(0)
 
+# ========== Shared-Memory Fallback Mode ==========
+elif len(sys.argv) == 3 and sys.argv[2].startswith("--shm="):
+    import shm_channel
+
+    try:
+        timeout = int(sys.argv[1])
+    except ValueError:
+        print("Invalid timeout value. Use: python3 script.py <timeout_seconds> --shm=<spec>")
+        sys.exit(1)
+
+    def infer(jpeg):
+        image = cv2.imdecode(np.frombuffer(jpeg, dtype=np.uint8), cv2.IMREAD_COLOR)
+        if image is None:
+            return False
+        model.setInput(preprocess(image))
+        _ = model.forward()[0]
+        return True
+
+    inference_times = shm_channel.serve(sys.argv[2][len("--shm="):], timeout, infer)
+
+    avg_time = np.mean(inference_times) if inference_times else 0
+
+    print("\n===== PYTHON FALLBACK SUMMARY =====")
+    print(f"Total images inferred:     {len(inference_times)}")
+    print(f"Model load time:           {model_load_time:.2f} ms")
+    print(f"Avg inference time:        {avg_time:.2f} ms")
+    print("====================================")
+
 # ========== Fallback Mode ==========
 elif len(sys.argv) == 2:
+    from fallback_fifo import DoneFifo
+
     try:
         timeout = int(sys.argv[1])
     except ValueError:
@@ -90,11 +126,7 @@ elif len(sys.argv) == 2:
 
     print(f"[INFO] Timeout set to {timeout} seconds.")
 
-    if not os.path.exists(fifo_path):
-        os.mkfifo(fifo_path)
-
-    fifo_out = open(fifo_path, "w")
-    print("[INFO] FIFO opened successfully.")
+    fifo = DoneFifo(fifo_path)
 
     inference_count = 0
     inference_times = []
@@ -112,6 +144,7 @@ elif len(sys.argv) == 2:
 
         if ':' not in line:
             print(f"[ERROR] Invalid input format (expected token:image_path): {line}", file=sys.stderr)
+            fifo.report(-1, 0, ok=False)
             continue
 
         token_str, _ = line.split(":", 1)
@@ -119,6 +152,7 @@ elif len(sys.argv) == 2:
 
         if not os.path.exists(default_image):
             print(f"[ERROR] Cannot find image: {default_image}", file=sys.stderr)
+            fifo.report(token_str, 0, ok=False)
             continue
 
         start_infer_time = time.perf_counter()
@@ -126,12 +160,10 @@ elif len(sys.argv) == 2:
 
         if image is None:
             print(f"[ERROR] Failed to load image: {default_image}", file=sys.stderr)
+            fifo.report(token_str, 0, ok=False)
             continue
 
-        blob = cv2.dnn.blobFromImage(
-            image, scalefactor=1.0/255, size=(224, 224),
-            mean=(0.485, 0.456, 0.406), swapRB=True, crop=False
-        )
+        blob = preprocess(image)
         model.setInput(blob)
         _ = model.forward()[0]
         end_infer_time = time.perf_counter()
@@ -139,16 +171,9 @@ elif len(sys.argv) == 2:
         infer_time = (end_infer_time - start_infer_time) * 1000
         inference_times.append(infer_time)
         inference_count += 1
+        fifo.report(token_str, infer_time)
 
-        try:
-            done_time_ms = int(time.time() * 1000)
-            fifo_out.write(f"{token_str},{infer_time:.2f},{done_time_ms}\n")
-            fifo_out.flush()
-            print(f"[INFO] Written result to FIFO: {token_str}, {infer_time:.2f} ms")
-        except Exception as e:
-            print(f"[ERROR] Failed to write to FIFO: {e}", file=sys.stderr)
-
-    fifo_out.close()
+    fifo.close()
     avg_time = np.mean(inference_times) if inference_times else 0
 
     print("\n===== PYTHON FALLBACK SUMMARY =====")
@@ -160,5 +185,6 @@ elif len(sys.argv) == 2:
 else:
     print("Usage:")
     print("  python3 script.py <timeout_seconds>")
+    print("  python3 script.py <timeout_seconds> --shm=<name>,<task_fd>,<done_fd>")
     print("  python3 script.py <image_directory> <num_images>")
     sys.exit(1)
@@ -0,0 +1,234 @@
+// Shared-memory channel between the ED and an out-of-process fallback
+// worker (torch-only models that cannot run in process).
+//
+// One POSIX shm segment holds a header, two single-producer/single-consumer
+// rings of fixed-size descriptors and a slot area:
+//   task ring: ED -> worker, token + slot + image length
+//   done ring: worker -> ED, token + slot + timing
+// The ED copies the JPEG into a free slot and the worker decodes it from
+// there, so a hand-off is a descriptor write and one eventfd signal, with no
+// paths, text or file reads. Each direction has an eventfd the producer
+// writes 1 to per published entry. Consumers take exactly as many entries
+// as they read from it: the eventfd's kernel locking orders the entries
+// before the signal, which the python side, having no atomics, relies on.
+// A descriptor with token -1 closes that direction.
+//
+// Layout (host byte order, offsets in the header; shm_channel.py mirrors it):
+//   header   magic, version, ring_size, slot_count, slot_size,
+//            task_ring, done_ring, slots                      8 x u32
+//   ring     head (consumer) at +0, tail (producer) at +64, entries at +128
+//   slots    slot_count x slot_size bytes
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+namespace shm {
+
+const uint32_t MAGIC   = 0x4F4D5352;  // "OMSR"
+const uint32_t VERSION = 1;
+const int32_t CLOSE_TOKEN = -1;
+
+struct TaskDesc {
+    int32_t  token;
+    uint32_t slot;
+    uint32_t len;       // image bytes in the slot
+    uint32_t reserved;
+};
+
+struct DoneDesc {
+    int32_t  token;
+    uint32_t slot;
+    uint32_t infer_us;  // worker's inference time
+    uint32_t status;    // 0 = ok, else the worker could not run it
+    uint64_t done_ms;   // wall clock at completion, like the FIFO's done_ms
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_size;  // entries per ring, a power of two
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint32_t task_ring;  // byte offsets from the start of the segment
+    uint32_t done_ring;
+    uint32_t slots;
+};
+
+const size_t RING_ENTRIES = 128;  // offset of the entries in a ring
+
+static_assert(sizeof(TaskDesc) == 16 && sizeof(DoneDesc) == 24 && sizeof(Header) == 32, "layout is shared with python");
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && sizeof(int) == sizeof(uint32_t), "ring indices must be lock-free across processes");
+
+// View of one ring inside the mapped segment
+template <typename T>
+class Ring {
+public:
+    void attach(char* base, uint32_t size, bool init) {
+        if (init) {
+            new (base) std::atomic<uint32_t>(0);
+            new (base + 64) std::atomic<uint32_t>(0);
+        }
+        head_ = reinterpret_cast<std::atomic<uint32_t>*>(base);
+        tail_ = reinterpret_cast<std::atomic<uint32_t>*>(base + 64);
+        entries_ = reinterpret_cast<T*>(base + RING_ENTRIES);
+        mask_ = size - 1;
+    }
+
+    bool push(const T& item) {
+        uint32_t tail = tail_->load(std::memory_order_relaxed);
+        if (tail - head_->load(std::memory_order_acquire) > mask_) return false;
+        entries_[tail & mask_] = item;
+        tail_->store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        uint32_t head = head_->load(std::memory_order_relaxed);
+        if (head == tail_->load(std::memory_order_acquire)) return false;
+        item = entries_[head & mask_];
+        head_->store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    static size_t bytes(uint32_t size) { return RING_ENTRIES + size * sizeof(T); }
+
+private:
+    std::atomic<uint32_t>* head_ = nullptr;
+    std::atomic<uint32_t>* tail_ = nullptr;
+    T* entries_ = nullptr;
+    uint32_t mask_ = 0;
+};
+
+// ED side: creates the segment and both eventfds, which a child started
+// with popen() inherits (they are not close-on-exec).
+class Channel {
+public:
+    ~Channel() {
+        if (base_) munmap(base_, size_);
+        if (!name_.empty()) shm_unlink(name_.c_str());
+        if (task_fd_ >= 0) close(task_fd_);
+        if (done_fd_ >= 0) close(done_fd_);
+    }
+
+    bool create(const std::string& name, uint32_t slot_count, uint32_t slot_size) {
+        uint32_t ring_size = 8;
+        while (ring_size <= slot_count) ring_size *= 2;  // room for the close entry too
+        slot_size = (slot_size + 63) & ~63u;
+        size_t task_ring = 64;
+        size_t done_ring = task_ring + Ring<TaskDesc>::bytes(ring_size);
+        size_t slots = (done_ring + Ring<DoneDesc>::bytes(ring_size) + 4095) & ~size_t(4095);
+        size_ = slots + size_t(slot_count) * slot_size;
+
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) return false;
+        name_ = name;
+        bool ok = ftruncate(fd, size_) == 0;
+        void* base = ok ? mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (base == MAP_FAILED) return false;
+        base_ = static_cast<char*>(base);
+
+        Header* h = reinterpret_cast<Header*>(base_);
+        *h = Header{MAGIC, VERSION, ring_size, slot_count, slot_size, static_cast<uint32_t>(task_ring),
+                    static_cast<uint32_t>(done_ring), static_cast<uint32_t>(slots)};
+        tasks_.attach(base_ + task_ring, ring_size, true);
+        done_.attach(base_ + done_ring, ring_size, true);
+        slot_size_ = slot_size;
+        slots_ = base_ + slots;
+        for (uint32_t s = slot_count; s > 0; --s) free_slots_.push_back(s - 1);
+
+        task_fd_ = eventfd(0, 0);
+        done_fd_ = eventfd(0, 0);
+        return task_fd_ >= 0 && done_fd_ >= 0;
+    }
+
+    // "name,task_fd,done_fd", what the worker needs to attach
+    std::string spec() const {
+        return name_ + "," + std::to_string(task_fd_) + "," + std::to_string(done_fd_);
+    }
+
+    uint32_t slot_size() const { return slot_size_; }
+
+    // A descriptor that reports an error once the worker is gone, such as
+    // the write end of its stdin pipe, so wait_done() notices a crash.
+    void watch(int fd) { peer_fd_ = fd; }
+
+    // Copies len bytes into a free slot and hands them to the worker. False
+    // if they do not fit or every slot is in use.
+    bool submit(int32_t token, const char* data, uint32_t len) {
+        uint32_t slot;
+        {
+            std::lock_guard<std::mutex> lock(slot_mutex_);
+            if (len > slot_size_ || free_slots_.empty()) return false;
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+        }
+        memcpy(slots_ + size_t(slot) * slot_size_, data, len);
+        return publish(TaskDesc{token, slot, len, 0});
+    }
+
+    // Tells the worker no more tasks will come
+    void close_tasks() { publish(TaskDesc{CLOSE_TOKEN, 0, 0, 0}); }
+
+    // Blocks for the next completion and frees its slot. False once the
+    // worker has closed its side.
+    bool wait_done(DoneDesc& done) {
+        while (true) {
+            if (signalled_ == 0) {
+                pollfd fds[2] = {{done_fd_, POLLIN, 0}, {peer_fd_, 0, 0}};
+                if (poll(fds, peer_fd_ >= 0 ? 2 : 1, -1) < 0) {
+                    if (errno == EINTR) continue;
+                    return false;
+                }
+                if (!(fds[0].revents & POLLIN)) return false;  // worker gone without closing
+                uint64_t n;
+                if (read(done_fd_, &n, sizeof(n)) != sizeof(n)) return false;
+                signalled_ = n;
+            }
+            if (!done_.pop(done)) return false;  // signalled but nothing published
+            signalled_--;
+            if (done.token == CLOSE_TOKEN) return false;
+            std::lock_guard<std::mutex> lock(slot_mutex_);
+            free_slots_.push_back(done.slot);
+            return true;
+        }
+    }
+
+private:
+    bool publish(const TaskDesc& task) {
+        {
+            std::lock_guard<std::mutex> lock(push_mutex_);
+            if (!tasks_.push(task)) return false;
+        }
+        uint64_t one = 1;
+        return write(task_fd_, &one, sizeof(one)) == sizeof(one);
+    }
+
+    std::string name_;
+    char* base_ = nullptr;
+    size_t size_ = 0;
+    char* slots_ = nullptr;
+    uint32_t slot_size_ = 0;
+    int task_fd_ = -1;
+    int done_fd_ = -1;
+    int peer_fd_ = -1;
+    Ring<TaskDesc> tasks_;
+    Ring<DoneDesc> done_;
+    std::mutex push_mutex_;       // close_tasks() may race the dispatcher
+    std::mutex slot_mutex_;
+    std::vector<uint32_t> free_slots_;
+    uint64_t signalled_ = 0;      // done entries signalled but not yet popped
+};
+
+}  // namespace shm
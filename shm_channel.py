@@ -0,0 +1,117 @@
+"""Worker side of the ED's shared-memory fallback channel (shm_channel.h).
+
+The ED starts the helper with --shm=<name>,<task_fd>,<done_fd>. Tasks arrive
+as (token, slot, JPEG bytes in the slot) without any text on a pipe, and
+completions go back as fixed descriptors. Python has no atomics, so entries
+are only consumed as far as the eventfd count read says they were published.
+"""
+import mmap
+import os
+import select
+import struct
+import sys
+import time
+
+MAGIC = 0x4F4D5352
+VERSION = 1
+CLOSE_TOKEN = -1
+RING_ENTRIES = 128          # offset of the entries in a ring
+TASK = struct.Struct("=iIII")   # token, slot, len, reserved
+DONE = struct.Struct("=iIIIQ")  # token, slot, infer_us, status, done_ms
+INDEX = struct.Struct("=I")
+
+
+class ShmChannel:
+    def __init__(self, spec):
+        name, task_fd, done_fd = spec.split(",")
+        self.task_fd = int(task_fd)
+        self.done_fd = int(done_fd)
+        fd = os.open("/dev/shm/" + name.lstrip("/"), os.O_RDWR)
+        try:
+            self.buf = mmap.mmap(fd, 0)
+        finally:
+            os.close(fd)
+        (magic, version, self.ring_size, self.slot_count, self.slot_size,
+         self.task_ring, self.done_ring, self.slots) = struct.unpack_from("=8I", self.buf, 0)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError("not an OMS shm channel: " + name)
+        self.view = memoryview(self.buf)
+        self.signalled = 0
+        self.closed = False
+
+    def next_task(self, timeout=None):
+        """Returns (token, slot, image bytes as a memoryview into the slot),
+        or None once the ED closed the channel or timeout seconds passed."""
+        if self.closed:
+            return None
+        if self.signalled == 0:
+            ready, _, _ = select.select([self.task_fd], [], [], timeout)
+            if not ready:
+                return None
+            self.signalled = struct.unpack("=Q", os.read(self.task_fd, 8))[0]
+        head = INDEX.unpack_from(self.buf, self.task_ring)[0]
+        entry = self.task_ring + RING_ENTRIES + (head % self.ring_size) * TASK.size
+        token, slot, length, _ = TASK.unpack_from(self.buf, entry)
+        INDEX.pack_into(self.buf, self.task_ring, (head + 1) & 0xFFFFFFFF)
+        self.signalled -= 1
+        if token == CLOSE_TOKEN:
+            self.closed = True
+            return None
+        start = self.slots + slot * self.slot_size
+        return token, slot, self.view[start:start + length]
+
+    def done(self, token, slot, infer_ms, ok=True):
+        """Reports a task finished; its slot goes back to the ED."""
+        self._publish(DONE.pack(token, slot, int(infer_ms * 1000), 0 if ok else 1, int(time.time() * 1000)))
+
+    def close(self):
+        """Tells the ED this worker is exiting."""
+        self._publish(DONE.pack(CLOSE_TOKEN, 0, 0, 0, 0))
+
+    def _publish(self, record):
+        tail_at = self.done_ring + 64
+        tail = INDEX.unpack_from(self.buf, tail_at)[0]
+        entry = self.done_ring + RING_ENTRIES + (tail % self.ring_size) * DONE.size
+        self.buf[entry:entry + DONE.size] = record
+        INDEX.pack_into(self.buf, tail_at, (tail + 1) & 0xFFFFFFFF)
+        os.write(self.done_fd, struct.pack("=Q", 1))
+
+
+def serve(spec, timeout, infer):
+    """Runs the ED's tasks until it closes the channel or timeout seconds
+    pass. infer(jpeg) gets a task's image bytes and returns False, or
+    raises, if it could not run the task, which the ED then counts as
+    failed. Returns the inference times (ms) of the tasks that ran."""
+    channel = ShmChannel(spec)
+    print(f"[INFO] Timeout set to {timeout} seconds, tasks through shared memory.")
+    inference_times = []
+    start_time = time.time()
+    try:
+        while True:
+            remaining = timeout - (time.time() - start_time)
+            if remaining <= 0:
+                print("[INFO] Time limit reached, exiting...")
+                break
+            task = channel.next_task(remaining)
+            if task is None:
+                if channel.closed:
+                    break
+                continue
+            token, slot, jpeg = task
+
+            start_infer = time.perf_counter()
+            try:
+                ok = infer(jpeg)
+            except Exception as e:
+                print(f"[ERROR] Task {token} raised: {e}", file=sys.stderr)
+                ok = False
+            if not ok:
+                print(f"[ERROR] Could not run task {token}", file=sys.stderr)
+                channel.done(token, slot, 0, ok=False)
+                continue
+            infer_time = (time.perf_counter() - start_infer) * 1000
+            inference_times.append(infer_time)
+            channel.done(token, slot, infer_time)
+    finally:
+        channel.close()
+    return inference_times
@@ -0,0 +1,83 @@
+// Bounded blocking queue between two pipeline stages.
+//
+// push() blocks while the queue is full, so a slow stage holds back the
+// ones feeding it instead of letting work pile up in memory; a producer
+// that must not block, such as an event loop, uses try_push(). Besides the
+// usual single pop() the consumer can take a batch, waiting a little for
+// more items to arrive.
+#pragma once
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+template <typename T>
+class StageQueue {
+public:
+    explicit StageQueue(size_t capacity = SIZE_MAX) : capacity_(capacity) {}
+
+    void set_capacity(size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity;
+    }
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    // False, leaving item untouched, if the queue is full
+    bool try_push(T& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.size() >= capacity_) return false;
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    T pop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !items_.empty(); });
+        T item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return item;
+    }
+
+    // Blocks for the first item, then keeps collecting until out holds max
+    // items, wait has passed since the first one, or more_coming() says
+    // nothing else is on its way. more_coming is called with the queue lock
+    // held and gets the number of items taken so far.
+    template <typename MoreComing>
+    void pop_batch(std::vector<T>& out, size_t max, std::chrono::milliseconds wait, MoreComing more_coming) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !items_.empty(); });
+        auto give_up = std::chrono::steady_clock::now() + wait;
+        while (true) {
+            while (!items_.empty() && out.size() < max) {
+                out.push_back(std::move(items_.front()));
+                items_.pop_front();
+                not_full_.notify_one();
+            }
+            if (out.size() == max || !more_coming(out.size())) break;
+            if (not_empty_.wait_until(lock, give_up) == std::cv_status::timeout && items_.empty()) break;
+        }
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<T> items_;
+    size_t capacity_;
+};
@@ -0,0 +1,137 @@
+// Per-worker task deques with work stealing.
+//
+// push() hands an item to the worker with the shortest deque. A worker pops
+// the oldest item of its own deque and, when that is empty, steals the
+// newest item of the longest other deque, the one its owner would have run
+// last. Each deque has its own lock, so workers only contend while stealing;
+// idle workers sleep on one condition variable.
+#pragma once
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+template <typename T>
+class StealQueue {
+public:
+    explicit StealQueue(size_t workers = 1) { resize(workers); }
+
+    // Only before any worker runs
+    void resize(size_t workers) {
+        lanes_.clear();
+        for (size_t w = 0; w < std::max<size_t>(1, workers); ++w) lanes_.emplace_back(new Lane);
+    }
+
+    size_t workers() const { return lanes_.size(); }
+
+    void push(T item) {
+        Lane* target = lanes_[0].get();
+        size_t shortest = SIZE_MAX;
+        for (auto& lane : lanes_) {
+            std::lock_guard<std::mutex> lock(lane->mutex);
+            if (lane->items.size() < shortest) {
+                shortest = lane->items.size();
+                target = lane.get();
+            }
+        }
+        // Counted before the lane is unlocked, so a taker never sees it
+        // uncounted, and a woken worker always finds it in a lane
+        {
+            std::lock_guard<std::mutex> lock(target->mutex);
+            target->items.push_back(std::move(item));
+            std::lock_guard<std::mutex> wait_lock(wait_mutex_);
+            queued_++;
+        }
+        ready_.notify_one();
+    }
+
+    // Blocks until worker gets an item; false once closed and empty.
+    bool pop(size_t worker, T& item) {
+        while (true) {
+            if (take(worker, item)) return true;
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            ready_.wait(lock, [this] { return queued_ > 0 || closed_; });
+            if (queued_ == 0 && closed_) return false;
+        }
+    }
+
+    // Removes the first item matching pred from whichever deque holds it
+    template <typename Pred>
+    bool remove_if(Pred pred) {
+        for (auto& lane : lanes_) {
+            std::lock_guard<std::mutex> lock(lane->mutex);
+            for (auto it = lane->items.begin(); it != lane->items.end(); ++it) {
+                if (!pred(*it)) continue;
+                lane->items.erase(it);
+                std::lock_guard<std::mutex> wait_lock(wait_mutex_);
+                queued_--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        return queued_;
+    }
+
+    // No more pushes; workers drain what is left, then pop() returns false
+    void close() {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        closed_ = true;
+        ready_.notify_all();
+    }
+
+private:
+    struct Lane {
+        std::mutex mutex;
+        std::deque<T> items;
+    };
+
+    bool take(size_t worker, T& item) {
+        Lane& own = *lanes_[worker];
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.items.empty()) {
+                item = std::move(own.items.front());
+                own.items.pop_front();
+                return taken();
+            }
+        }
+        // Steal from the longest deque; sizes may change before we lock it,
+        // in which case the caller simply tries again
+        Lane* victim = nullptr;
+        size_t longest = 0;
+        for (auto& lane : lanes_) {
+            if (lane.get() == &own) continue;
+            std::lock_guard<std::mutex> lock(lane->mutex);
+            if (lane->items.size() > longest) {
+                longest = lane->items.size();
+                victim = lane.get();
+            }
+        }
+        if (!victim) return false;
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (victim->items.empty()) return false;
+        item = std::move(victim->items.back());
+        victim->items.pop_back();
+        return taken();
+    }
+
+    bool taken() {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        queued_--;
+        return true;
+    }
+
+    std::vector<std::unique_ptr<Lane>> lanes_;
+    std::mutex wait_mutex_;
+    std::condition_variable ready_;
+    size_t queued_ = 0;   // items in all deques, guarded by wait_mutex_
+    bool closed_ = false;
+};
@@ -0,0 +1,71 @@
+// StealQueue checks: lane order, and owners racing thieves for the same items
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "steal_queue.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #cond " failed\n";  \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+// Owners run their own lane oldest first; a thief takes the newest item
+static void test_order() {
+    StealQueue<int> queue(2);
+    for (int i = 1; i <= 4; ++i) queue.push(i);  // lanes [1, 3] and [2, 4]
+    int item = 0;
+    CHECK(queue.pop(0, item) && item == 1);
+    CHECK(queue.pop(0, item) && item == 3);
+    CHECK(queue.pop(0, item) && item == 4);
+    CHECK(queue.pop(1, item) && item == 2);
+    CHECK(queue.size() == 0);
+    queue.close();
+    CHECK(!queue.pop(0, item));
+}
+
+// Workers drain their lanes while stealing from each other and a producer
+// keeps pushing; every item must come out exactly once
+static void test_owner_vs_thief() {
+    const int workers = 4;
+    const int items = 200000;
+    StealQueue<int> queue(workers);
+    std::vector<std::atomic<int>> seen(items);
+    for (auto& count : seen) count = 0;
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; ++w) {
+        threads.emplace_back([&queue, &seen, w] {
+            int item;
+            while (queue.pop(w, item)) seen[item]++;
+        });
+    }
+    for (int i = 0; i < items; ++i) queue.push(i);
+    queue.close();
+    for (auto& t : threads) t.join();
+
+    int missing = 0, duplicated = 0;
+    for (auto& count : seen) {
+        if (count == 0) missing++;
+        if (count > 1) duplicated++;
+    }
+    CHECK(missing == 0);
+    CHECK(duplicated == 0);
+    CHECK(queue.size() == 0);
+}
+
+int main() {
+    test_order();
+    test_owner_vs_thief();
+    if (failures) {
+        std::cerr << "[steal_queue_test] " << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << "[steal_queue_test] passed\n";
+    return 0;
+}
@@ -65,8 +65,38 @@ if len(sys.argv) == 3 and os.path.isdir(sys.argv[1]):
     print("=================================")
     sys.exit(0)
 
+# ========== Shared-Memory Fallback Mode ==========
+if len(sys.argv) == 3 and sys.argv[2].startswith("--shm="):
+    import cv2
+    import shm_channel
+
+    try:
+        timeout = int(sys.argv[1])
+    except ValueError:
+        print("Usage: python3 yolo_fallback.py <timeout_seconds> --shm=<spec>")
+        sys.exit(1)
+
+    def infer(jpeg):
+        image = cv2.imdecode(np.frombuffer(jpeg, dtype=np.uint8), cv2.IMREAD_COLOR)
+        if image is None:
+            return False
+        results = model(image[..., ::-1])  # torch hub expects RGB arrays
+        return True
+
+    inference_times = shm_channel.serve(sys.argv[2][len("--shm="):], timeout, infer)
+
+    avg_time = np.mean(inference_times) if inference_times else 0
+    print("\n===== YOLOv5 FALLBACK SUMMARY =====")
+    print(f"Total images inferred:     {len(inference_times)}")
+    print(f"Model load time:           {model_load_time:.2f} ms")
+    print(f"Avg inference time:        {avg_time:.2f} ms")
+    print("====================================")
+    sys.exit(0)
+
 # ========== Fallback Mode ==========
 if len(sys.argv) == 2:
+    from fallback_fifo import DoneFifo
+
     try:
         timeout = int(sys.argv[1])
     except ValueError:
@@ -75,11 +105,7 @@ if len(sys.argv) == 2:
 
     print(f"[INFO] Timeout set to {timeout} seconds.")
 
-    if not os.path.exists(FIFO_PATH):
-        os.mkfifo(FIFO_PATH)
-
-    fifo_out = open(FIFO_PATH, "w")
-    print("[INFO] FIFO opened successfully.")
+    fifo = DoneFifo(FIFO_PATH)
 
     inference_times = []
     inference_count = 0
@@ -95,6 +121,7 @@ if len(sys.argv) == 2:
             continue
         if ':' not in line:
             print(f"[ERROR] Invalid input format: {line}", file=sys.stderr)
+            fifo.report(-1, 0, ok=False)
             continue
 
         token_str, image_path = line.split(':', 1)
@@ -102,6 +129,7 @@ if len(sys.argv) == 2:
 
         if not os.path.exists(image_path):
             print(f"[ERROR] Image not found: {image_path}", file=sys.stderr)
+            fifo.report(token_str, 0, ok=False)
             continue
 
         start_infer = time.perf_counter()
@@ -111,16 +139,9 @@ if len(sys.argv) == 2:
         infer_time = (end_infer - start_infer) * 1000
         inference_times.append(infer_time)
         inference_count += 1
+        fifo.report(token_str, infer_time)
 
-        try:
-            done_time_ms = int(time.time() * 1000)
-            fifo_out.write(f"{token_str},{infer_time:.2f},{done_time_ms}\n")
-            fifo_out.flush()
-            print(f"[INFO] Written result to FIFO: {token_str}, {infer_time:.2f} ms")
-        except Exception as e:
-            print(f"[ERROR] Failed to write to FIFO: {e}", file=sys.stderr)
-
-    fifo_out.close()
+    fifo.close()
     avg_time = np.mean(inference_times) if inference_times else 0
     print("\n===== YOLOv5 FALLBACK SUMMARY =====")
     print(f"Total images inferred:     {inference_count}")
@@ -130,5 +151,6 @@ if len(sys.argv) == 2:
 else:
     print("Usage:")
     print("  python3 yolo_fallback.py <timeout_seconds>")
+    print("  python3 yolo_fallback.py <timeout_seconds> --shm=<name>,<task_fd>,<done_fd>")
     print("  python3 yolo_fallback.py <image_directory> <num_images>")
     sys.exit(1)